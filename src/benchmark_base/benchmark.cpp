@@ -0,0 +1,195 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+percentiles_t calculate_percentiles(std::vector<double> values)
+{
+    percentiles_t res = { 0.0, 0.0, 0.0, 0.0 };
+    // frames without a gpu scope hold NaN, they do not count towards its statistics
+    values.erase(std::remove_if(values.begin(), values.end(), [](double v) { return std::isnan(v); }), values.end());
+    if (values.empty())
+    {
+        return res;
+    }
+
+    std::sort(values.begin(), values.end());
+    auto rank = [&](double p) { return values[static_cast<std::size_t>(std::ceil(p * values.size())) - 1]; };
+    res.p50 = rank(0.50);
+    res.p95 = rank(0.95);
+    res.p99 = rank(0.99);
+    res.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    return res;
+}
+
+void benchmark_t::add_sample(const frame_sample_t& sample)
+{
+    if (sample.frame < this->warmup_frames)
+    {
+        return;
+    }
+    for (const std::pair<std::string, double>& scope : sample.gpu_ms)
+    {
+        if (std::find(this->gpu_scopes.begin(), this->gpu_scopes.end(), scope.first) == this->gpu_scopes.end())
+        {
+            this->gpu_scopes.push_back(scope.first);
+        }
+    }
+    this->samples.push_back(sample);
+}
+
+void benchmark_t::add_gpu_timings(std::uint32_t frame, const std::vector<std::pair<std::string, double>>& gpu_ms)
+{
+    // samples are added in frame order, frames of the warmup have none
+    auto it = std::lower_bound(this->samples.begin(), this->samples.end(), frame, [](const frame_sample_t& s, std::uint32_t f) { return s.frame < f; });
+    if (it == this->samples.end() || it->frame != frame)
+    {
+        return;
+    }
+    for (const std::pair<std::string, double>& scope : gpu_ms)
+    {
+        if (std::find(this->gpu_scopes.begin(), this->gpu_scopes.end(), scope.first) == this->gpu_scopes.end())
+        {
+            this->gpu_scopes.push_back(scope.first);
+        }
+    }
+    it->gpu_ms = gpu_ms;
+}
+
+std::uint32_t benchmark_t::get_sample_count() const
+{
+    return static_cast<std::uint32_t>(this->samples.size());
+}
+
+std::vector<std::string> benchmark_t::get_columns() const
+{
+    std::vector<std::string> columns = { "frame_ms", "fence_wait_ms", "record_ms", "submit_ms", "present_ms" };
+    for (const std::string& scope : this->gpu_scopes)
+    {
+        columns.push_back("gpu_" + scope + "_ms");
+    }
+    return columns;
+}
+
+std::vector<double> benchmark_t::get_column(std::uint32_t index) const
+{
+    std::vector<double> values;
+    values.reserve(this->samples.size());
+    for (const frame_sample_t& sample : this->samples)
+    {
+        switch (index)
+        {
+            case 0: values.push_back(sample.frame_ms); break;
+            case 1: values.push_back(sample.fence_wait_ms); break;
+            case 2: values.push_back(sample.record_ms); break;
+            case 3: values.push_back(sample.submit_ms); break;
+            case 4: values.push_back(sample.present_ms); break;
+            default:
+            {
+                const std::string& name = this->gpu_scopes[index - 5];
+                auto it = std::find_if(sample.gpu_ms.begin(), sample.gpu_ms.end(), [&](const auto& e) { return e.first == name; });
+                // every column keeps one entry per sample so the rows stay aligned with the frames
+                values.push_back((it != sample.gpu_ms.end()) ? it->second : std::numeric_limits<double>::quiet_NaN());
+                break;
+            }
+        }
+    }
+    return values;
+}
+
+std::int32_t benchmark_t::write_csv(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open file: " << path << "!" << std::endl;
+        return -1;
+    }
+
+    std::vector<std::string> columns = get_columns();
+    file << "frame";
+    for (const std::string& column : columns)
+    {
+        file << "," << column;
+    }
+    file << "\n" << std::fixed << std::setprecision(4);
+
+    std::vector<std::vector<double>> values;
+    for (std::uint32_t i = 0; i < columns.size(); ++i)
+    {
+        values.push_back(get_column(i));
+    }
+    for (std::size_t row = 0; row < this->samples.size(); ++row)
+    {
+        file << this->samples[row].frame;
+        for (const std::vector<double>& column : values)
+        {
+            file << ",";
+            if (!std::isnan(column[row])) file << column[row];
+        }
+        file << "\n";
+    }
+
+    return 0;
+}
+
+std::int32_t benchmark_t::write_json(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open file: " << path << "!" << std::endl;
+        return -1;
+    }
+
+    std::vector<std::string> columns = get_columns();
+    file << std::fixed << std::setprecision(4);
+    file << "{\n";
+    file << "  \"frames\": " << this->samples.size() << ",\n";
+    file << "  \"warmup_frames\": " << this->warmup_frames << ",\n";
+    file << "  \"summary\": {\n";
+    for (std::uint32_t i = 0; i < columns.size(); ++i)
+    {
+        percentiles_t p = calculate_percentiles(get_column(i));
+        file << "    \"" << columns[i] << "\": { \"mean\": " << p.mean << ", \"p50\": " << p.p50 << ", \"p95\": " << p.p95 << ", \"p99\": " << p.p99 << " }";
+        file << ((i + 1 < columns.size()) ? ",\n" : "\n");
+    }
+    file << "  },\n";
+    file << "  \"samples\": [\n";
+    for (std::size_t row = 0; row < this->samples.size(); ++row)
+    {
+        const frame_sample_t& sample = this->samples[row];
+        file << "    { \"frame\": " << sample.frame << ", \"frame_ms\": " << sample.frame_ms << ", \"fence_wait_ms\": " << sample.fence_wait_ms
+            << ", \"record_ms\": " << sample.record_ms << ", \"submit_ms\": " << sample.submit_ms << ", \"present_ms\": " << sample.present_ms;
+        for (const std::pair<std::string, double>& scope : sample.gpu_ms)
+        {
+            file << ", \"gpu_" << scope.first << "_ms\": " << scope.second;
+        }
+        file << ((row + 1 < this->samples.size()) ? " },\n" : " }\n");
+    }
+    file << "  ]\n";
+    file << "}\n";
+
+    return 0;
+}
+
+void benchmark_t::print_summary() const
+{
+    std::vector<std::string> columns = get_columns();
+    std::cout << "Benchmark: " << this->samples.size() << " frames" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (std::uint32_t i = 0; i < columns.size(); ++i)
+    {
+        percentiles_t p = calculate_percentiles(get_column(i));
+        std::cout << "\t" << std::left << std::setw(28) << columns[i] << "mean " << p.mean << "\tp50 " << p.p50 << "\tp95 " << p.p95 << "\tp99 " << p.p99 << std::endl;
+    }
+}
+
+benchmark_t::benchmark_t(std::uint32_t warmup_frames)
+{
+    this->warmup_frames = warmup_frames;
+}
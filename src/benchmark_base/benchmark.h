@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct frame_sample_t
+{
+    std::uint32_t frame = 0;
+    double frame_ms = 0.0;
+    double fence_wait_ms = 0.0;
+    double record_ms = 0.0;
+    double submit_ms = 0.0;
+    double present_ms = 0.0;
+    std::vector<std::pair<std::string, double>> gpu_ms;
+};
+
+struct percentiles_t
+{
+    double p50;
+    double p95;
+    double p99;
+    double mean;
+};
+
+class benchmark_t
+{
+    private:
+        std::vector<frame_sample_t> samples;
+        std::vector<std::string> gpu_scopes;
+
+        std::vector<std::string> get_columns() const;
+        std::vector<double> get_column(std::uint32_t index) const;
+
+    public:
+        std::uint32_t warmup_frames = 0;
+
+        void add_sample(const frame_sample_t& sample);
+        /// Attaches gpu timings to the sample of the frame they were recorded in, they arrive a few frames after its cpu timings.
+        void add_gpu_timings(std::uint32_t frame, const std::vector<std::pair<std::string, double>>& gpu_ms);
+        std::uint32_t get_sample_count() const;
+        std::int32_t write_csv(const std::string& path) const;
+        std::int32_t write_json(const std::string& path) const;
+        void print_summary() const;
+        benchmark_t(std::uint32_t warmup_frames = 0);
+};
+
+percentiles_t calculate_percentiles(std::vector<double> values);
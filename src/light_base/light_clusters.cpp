@@ -0,0 +1,100 @@
+#include "light_clusters.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+std::int32_t light_clusters_t::init(std::uint32_t light_capacity, vulkan_context_t* context)
+{
+    // empty storage buffers can not be bound, so there is always room for one light
+    this->light_capacity = std::max(1u, light_capacity);
+    for (std::uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        buffer_settings_t param_settings;
+        param_settings.size = sizeof(light_cluster_params_t);
+        param_settings.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        param_settings.memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (context->add_buffer(param_settings) != 0) return -1;
+        buffer_t* param_buffer = context->get_last_buffer();
+        param_buffer->map_memory();
+        this->param_buffers.push_back(param_buffer);
+
+        buffer_settings_t light_settings;
+        light_settings.size = this->light_capacity * sizeof(point_light_t);
+        light_settings.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        light_settings.memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (context->add_buffer(light_settings) != 0) return -1;
+        buffer_t* light_buffer = context->get_last_buffer();
+        light_buffer->map_memory();
+        this->light_buffers.push_back(light_buffer);
+
+        buffer_settings_t cluster_settings;
+        cluster_settings.size = static_cast<VkDeviceSize>(LIGHT_CLUSTER_COUNT) * (MAX_LIGHTS_PER_CLUSTER + 1) * sizeof(std::uint32_t);
+        cluster_settings.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        if (context->add_buffer(cluster_settings) != 0) return -1;
+        this->cluster_buffers.push_back(context->get_last_buffer());
+
+        buffer_settings_t overflow_settings;
+        overflow_settings.size = sizeof(std::uint32_t);
+        overflow_settings.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        overflow_settings.memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (context->add_buffer(overflow_settings) != 0) return -1;
+        buffer_t* overflow_buffer = context->get_last_buffer();
+        overflow_buffer->map_memory();
+        std::memset(overflow_buffer->mapped_memory, 0, sizeof(std::uint32_t));
+        this->overflow_buffers.push_back(overflow_buffer);
+    }
+
+    return 0;
+}
+
+std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>> light_clusters_t::get_descriptor_config()
+{
+    std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>> config = get_lighting_descriptor_config(0);
+    config.push_back(std::make_tuple(3, sizeof(std::uint32_t), &this->overflow_buffers[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, true));
+    return config;
+}
+
+std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>> light_clusters_t::get_lighting_descriptor_config(std::uint32_t first_binding)
+{
+    return {
+        std::make_tuple(first_binding, sizeof(light_cluster_params_t), &this->param_buffers[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, true),
+        std::make_tuple(first_binding + 1, this->light_capacity * sizeof(point_light_t), &this->light_buffers[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, true),
+        std::make_tuple(first_binding + 2, static_cast<VkDeviceSize>(LIGHT_CLUSTER_COUNT) * (MAX_LIGHTS_PER_CLUSTER + 1) * sizeof(std::uint32_t),
+                &this->cluster_buffers[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, true)
+    };
+}
+
+void light_clusters_t::update(std::uint32_t frame, const glm::mat4& view, const glm::mat4& projection, VkExtent2D extent, float near_plane, float far_plane,
+        const std::vector<point_light_t>& lights)
+{
+    this->light_count = std::min(this->light_capacity, static_cast<std::uint32_t>(lights.size()));
+    light_cluster_params_t params;
+    params.view = view;
+    params.inverse_projection = glm::inverse(projection);
+    params.screen = glm::vec4(static_cast<float>(extent.width), static_cast<float>(extent.height), near_plane, far_plane);
+    params.light_count = this->light_count;
+    std::memcpy(this->param_buffers[frame]->mapped_memory, &params, sizeof(light_cluster_params_t));
+    if (this->light_count > 0) std::memcpy(this->light_buffers[frame]->mapped_memory, lights.data(), this->light_count * sizeof(point_light_t));
+}
+
+void light_clusters_t::check_overflow(std::uint32_t frame)
+{
+    // the maximum only grows, so a stale read at worst reports the overflow a few frames late
+    std::uint32_t most_lights = *static_cast<const std::uint32_t*>(this->overflow_buffers[frame]->mapped_memory);
+    if (this->overflow_reported || most_lights <= MAX_LIGHTS_PER_CLUSTER) return;
+    std::cerr << "Light clusters overflowed, a froxel is touched by " << most_lights << " lights but only holds " << MAX_LIGHTS_PER_CLUSTER << "!" << std::endl;
+    this->overflow_reported = true;
+}
+
+void light_clusters_t::record_binning(VkCommandBuffer command_buffer, vulkan_context_t* context, std::uint32_t pipeline_index, std::uint32_t pool_index)
+{
+    // the clusters only depend on the camera, so they are binned before the render pass instead of from the g-buffer depth
+    context->bind_compute_pipeline(command_buffer, pipeline_index, pool_index);
+    vkCmdDispatch(command_buffer, (LIGHT_CLUSTER_COUNT + LIGHT_WORKGROUP_SIZE - 1) / LIGHT_WORKGROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier bin_barrier{};
+    bin_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    bin_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    bin_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &bin_barrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../vulkan_base/vulkan_base.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+#define MAX_LIGHTS_PER_CLUSTER 128
+#define LIGHT_WORKGROUP_SIZE 64
+#define LIGHT_OVERLAP 16.0f
+
+/// Matches the std430 light layout in light_clusters.comp and main.frag, the light only reaches up to radius in position.w.
+struct point_light_t
+{
+    alignas(16) glm::vec4 position;
+    alignas(16) glm::vec4 color;
+};
+
+/// Shared by the binning pass and the lighting subpass, the slices split the view depth between near and far exponentially.
+struct light_cluster_params_t
+{
+    alignas(16) glm::mat4 view;
+    alignas(16) glm::mat4 inverse_projection;
+    /// Width, height, near and far plane of the camera.
+    alignas(16) glm::vec4 screen;
+    alignas(4) std::uint32_t light_count;
+};
+
+inline const std::vector<VkDescriptorSetLayoutBinding> LIGHT_CLUSTER_LAYOUT_BINDINGS = {
+    { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }
+};
+
+/// Bins point lights into view space froxels with a compute pass, so the lighting subpass only shades a pixel against the lights of its froxel.
+/// Every froxel owns MAX_LIGHTS_PER_CLUSTER + 1 entries of the cluster buffer, the light count followed by the light indices.
+/// The binning pass also records the most lights any froxel was touched by, so dropped lights can be reported.
+class light_clusters_t
+{
+    private:
+        std::uint32_t light_capacity = 0;
+        std::uint32_t light_count = 0;
+        std::vector<buffer_t*> param_buffers;
+        std::vector<buffer_t*> light_buffers;
+        std::vector<buffer_t*> cluster_buffers;
+        std::vector<buffer_t*> overflow_buffers;
+        bool overflow_reported = false;
+
+    public:
+        std::int32_t init(std::uint32_t light_capacity, vulkan_context_t* context);
+        std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>> get_descriptor_config();
+        /// Bindings of the params, the lights and the clusters in the lighting subpass.
+        std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>> get_lighting_descriptor_config(std::uint32_t first_binding);
+        void update(std::uint32_t frame, const glm::mat4& view, const glm::mat4& projection, VkExtent2D extent, float near_plane, float far_plane,
+                const std::vector<point_light_t>& lights);
+        /// Warns once when a froxel of this frame's last binning had more lights than MAX_LIGHTS_PER_CLUSTER.
+        void check_overflow(std::uint32_t frame);
+        void record_binning(VkCommandBuffer command_buffer, vulkan_context_t* context, std::uint32_t pipeline_index, std::uint32_t pool_index);
+};
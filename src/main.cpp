@@ -4,11 +4,21 @@
 #include "vulkan_base/vulkan_base.h"
 #include "vulkan_base/vulkan_vertex.h"
 #include "model_base/model_base.h"
+#include "model_base/indirect_draws.h"
+#include "model_base/simplify.h"
+#include "light_base/light_clusters.h"
 #include "command_line_parser/command_line_parser.h"
 #include "user_base/camera.h"
+#include "user_base/camera_path.h"
+#include "user_base/shadow_cache.h"
+#include "benchmark_base/benchmark.h"
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <random>
 
 struct ubo_t
 {
@@ -23,12 +33,16 @@ struct shadow_map_t
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 projection;
     alignas(16) glm::vec3 light_pos;
+    alignas(16) glm::mat4 face_views[6];
 };
 
 struct view_t
 {
     alignas(16) glm::vec3 pos;
     alignas(16) glm::mat4 mat;
+    /// Takes clip space back to world space, the lighting pass rebuilds positions from the depth buffer with it.
+    alignas(16) glm::mat4 inverse_view_projection;
+    alignas(8) glm::vec2 extent;
 };
 
 struct flags_t
@@ -46,6 +60,7 @@ struct blinn_phong_t
     alignas(4) float linear;
     alignas(4) float quadratic;
     alignas(4) float far_plane;
+    alignas(4) float near_plane;
 };
 
 std::vector<vertex_t> vertices = {
@@ -88,21 +103,28 @@ void scroll_callback(GLFWwindow* window, double x_offset, double y_offset)
     if (camera_active) cam.zoom(y_offset);
 }
 
-void imgui_add_dependency(std::uint32_t subpass, std::uint32_t attachment, vulkan_context_t* vk_context, render_pass_settings_t& settings)
+std::int32_t write_ppm(const std::string& path, const std::vector<std::uint8_t>& pixels, std::uint32_t width, std::uint32_t height, VkFormat format)
 {
-    settings.add_subpass(vk_context->swap_chain->format.format, VK_SAMPLE_COUNT_1_BIT, &vk_context->physical_device);
-    settings.attachments.pop_back();
-    settings.subpasses.back().color_attachment_references.back().attachment = attachment;
-    VkSubpassDependency& imgui_dep = settings.dependencies.back();
-    imgui_dep.srcSubpass = subpass - 1;
-    imgui_dep.dstSubpass = subpass;
-    imgui_dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    imgui_dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    imgui_dep.srcAccessMask = 0;
-    imgui_dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open file: " << path << "!" << std::endl;
+        return -1;
+    }
+
+    bool bgra = (format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (std::size_t i = 0; i < static_cast<std::size_t>(width) * height; ++i)
+    {
+        const std::uint8_t* px = &pixels[i * 4];
+        char rgb[3] = { static_cast<char>(bgra ? px[2] : px[0]), static_cast<char>(px[1]), static_cast<char>(bgra ? px[0] : px[2]) };
+        file.write(rgb, 3);
+    }
+
+    return 0;
 }
 
-VkDescriptorPool imgui_setup(std::uint32_t subpass, vulkan_context_t* vk_context)
+VkDescriptorPool imgui_setup(render_pass_t* render_pass, std::uint32_t subpass, vulkan_context_t* vk_context)
 {
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -135,7 +157,7 @@ VkDescriptorPool imgui_setup(std::uint32_t subpass, vulkan_context_t* vk_context
     init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     init_info.Allocator = nullptr;
     init_info.CheckVkResultFn = [](VkResult err){ if (err == 0) return; fprintf(stderr, "[vulkan] Error: VkResult = %d\n", err); if (err < 0) abort(); };
-    ImGui_ImplVulkan_Init(&init_info, vk_context->render_passes.back()->render_pass);
+    ImGui_ImplVulkan_Init(&init_info, render_pass->render_pass);
 
     {
         VkCommandBuffer buf = begin_single_time_commands(vk_context->device->device, vk_context->command_pool);
@@ -152,6 +174,20 @@ int main(int argc, char** argv)
 
     std::uint32_t width = 1280, height = 720;
     bool flip_texture = true;
+    bool headless = false;
+    std::uint32_t frame_count = 1;
+    std::string output_path = "";
+    bool benchmark = false;
+    std::string benchmark_path = "./benchmark";
+    vertex_format_t vertex_format = VERTEX_FORMAT_FULL;
+    bool separate_shadow_faces = false;
+    bool shadow_cache_enabled = true;
+    bool frustum_culling = true;
+    bool gpu_culling = true;
+    bool lod_selection = true;
+    std::uint32_t instance_count = 1;
+    std::uint32_t point_light_count = 0;
+    bool albedo_override = false;
     std::string model_path = "./models/backpack/backpack.obj", albedo_path = "./models/backpack/albedo.jpg", specular_path = "./models/backpack/specular.jpg",
         normal_path = "./models/backpack/normal.png", metallic_path = "./models/backpack/metallic.jpg", roughness_path = "./models/backpack/roughness.jpg",
         ao_path = "./models/backpack/ao.jpg";
@@ -164,6 +200,20 @@ int main(int argc, char** argv)
         allowed_args["--model"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::STRING }, 1);
         allowed_args["--texture"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::STRING }, 1);
         allowed_args["--flip-texture"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--headless"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--frames"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::UINT }, 1);
+        allowed_args["--output"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::STRING }, 1);
+        allowed_args["--benchmark"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::UINT }, 1);
+        allowed_args["--benchmark-output"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::STRING }, 1);
+        allowed_args["--packed-vertices"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--quantize-positions"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--separate-shadow-faces"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--no-shadow-cache"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--no-frustum-culling"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--cpu-culling"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--instances"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::UINT }, 1);
+        allowed_args["--no-lod"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::NONE }, 0);
+        allowed_args["--lights"] = std::make_tuple(std::vector<value_type_t>{ value_type_t::UINT }, 1);
         auto opt_res = parse_command_line_arguments(argc - 1, argv + 1, allowed_args);
         bool show_usage = false;
 
@@ -192,11 +242,69 @@ int main(int argc, char** argv)
         if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--texture") == 0; }) != res.end())
         {
             albedo_path = res["--texture"][0].s;
+            albedo_override = true;
         }
         if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--flip-texture") == 0; }) != res.end())
         {
             flip_texture = false;
         }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--headless") == 0; }) != res.end())
+        {
+            headless = true;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--frames") == 0; }) != res.end())
+        {
+            frame_count = res["--frames"][0].u;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--output") == 0; }) != res.end())
+        {
+            output_path = res["--output"][0].s;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--benchmark") == 0; }) != res.end())
+        {
+            benchmark = true;
+            frame_count = res["--benchmark"][0].u;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--benchmark-output") == 0; }) != res.end())
+        {
+            benchmark_path = res["--benchmark-output"][0].s;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--packed-vertices") == 0; }) != res.end())
+        {
+            vertex_format = VERTEX_FORMAT_PACKED;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--quantize-positions") == 0; }) != res.end())
+        {
+            vertex_format = VERTEX_FORMAT_PACKED_QUANTIZED;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--separate-shadow-faces") == 0; }) != res.end())
+        {
+            separate_shadow_faces = true;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--no-shadow-cache") == 0; }) != res.end())
+        {
+            shadow_cache_enabled = false;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--no-frustum-culling") == 0; }) != res.end())
+        {
+            frustum_culling = false;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--cpu-culling") == 0; }) != res.end())
+        {
+            gpu_culling = false;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--instances") == 0; }) != res.end())
+        {
+            instance_count = std::max(1u, res["--instances"][0].u);
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--no-lod") == 0; }) != res.end())
+        {
+            lod_selection = false;
+        }
+        if (std::find_if(res.begin(), res.end(), [](auto e){ return std::strcmp(e.first.c_str(), "--lights") == 0; }) != res.end())
+        {
+            point_light_count = res["--lights"][0].u;
+        }
 
         if (show_usage)
         {
@@ -207,29 +315,87 @@ int main(int argc, char** argv)
             std::cout << "\t\t\"--height\":  specify the inital height of the window." << std::endl;
             std::cout << "\t\t\"--model\":   specify the path to the .obj file of the model." << std::endl;
             std::cout << "\t\t\"--texture\": specify the path to the texture of the model." << std::endl;
+            std::cout << "\t\t\"--headless\": render offscreen without creating a window." << std::endl;
+            std::cout << "\t\t\"--frames\":  number of frames to render in headless mode." << std::endl;
+            std::cout << "\t\t\"--output\":  write the last headless frame to this .ppm file." << std::endl;
+            std::cout << "\t\t\"--benchmark\": replay a scripted camera path for N frames and record frame timings." << std::endl;
+            std::cout << "\t\t\"--benchmark-output\": path prefix of the .csv and .json benchmark results." << std::endl;
+            std::cout << "\t\t\"--packed-vertices\": use octahedral normals and half float uvs for the model." << std::endl;
+            std::cout << "\t\t\"--quantize-positions\": like --packed-vertices, additionally quantize positions to 16 bit." << std::endl;
+            std::cout << "\t\t\"--separate-shadow-faces\": render the shadow cube map with one render pass per face instead of multiview." << std::endl;
+            std::cout << "\t\t\"--no-shadow-cache\": re-render the shadow cube map every frame, even if nothing moved." << std::endl;
+            std::cout << "\t\t\"--no-frustum-culling\": draw the whole model in the g-buffer pass instead of only the visible clusters." << std::endl;
+            std::cout << "\t\t\"--cpu-culling\": cull the clusters with the bvh on the cpu instead of a compute shader writing indirect draws." << std::endl;
+            std::cout << "\t\t\"--instances\": draw this many copies of the model on a grid with instanced draws." << std::endl;
+            std::cout << "\t\t\"--no-lod\": always draw the full detail mesh instead of picking a simplified level by screen size." << std::endl;
+            std::cout << "\t\t\"--lights\": add this many moving point lights, shaded through clustered lighting." << std::endl;
             return 0;
         }
     }
 
-    vulkan_context_t vk_context("Vulkan Template", width, height);
+    vulkan_context_t vk_context("Vulkan Template", width, height, headless);
     if (!vk_context.initialized)
     {
         glfwTerminate();
         return -1;
     }
 
-    glfwSetMouseButtonCallback(vk_context.window, mouse_button_callback);
-    glfwSetCursorPosCallback(vk_context.window, cursor_pos_callback);
-    glfwSetScrollCallback(vk_context.window, scroll_callback);
+    if (!headless)
+    {
+        glfwSetMouseButtonCallback(vk_context.window, mouse_button_callback);
+        glfwSetCursorPosCallback(vk_context.window, cursor_pos_callback);
+        glfwSetScrollCallback(vk_context.window, scroll_callback);
+    }
 
-    model_t model(model_path, false);
+    model_t model(model_path, false, true, vk_context.thread_pool);
     if (!model.is_initialized()) return -1;
-    auto bufs = model.set_up_buffer(&vk_context);
+    auto bufs = model.set_up_buffer(&vk_context, vertex_format);
     if (!bufs.has_value()) return -1;
     buffer_t* g_vertex_buffer = std::get<0>(bufs.value());
     buffer_t* g_index_buffer = std::get<1>(bufs.value());
+
+    // copies are laid out on a square grid in the xz plane around the origin, spaced by the model bounds
+    aabb_t model_bounds;
+    for (const submesh_t& submesh : model.submeshes) model_bounds.grow(submesh.bounds);
+    float instance_spacing = 1.25f * std::max(model_bounds.max.x - model_bounds.min.x, model_bounds.max.z - model_bounds.min.z);
+    std::uint32_t grid_side = static_cast<std::uint32_t>(std::ceil(std::sqrt(static_cast<float>(instance_count))));
+    model.instances.clear();
+    for (std::uint32_t i = 0; i < instance_count; ++i)
+    {
+        glm::vec3 offset = glm::vec3(static_cast<float>(i % grid_side), 0.0f, static_cast<float>(i / grid_side)) - glm::vec3((grid_side - 1) * 0.5f, 0.0f, (grid_side - 1) * 0.5f);
+        model.instances.push_back(glm::translate(glm::mat4(1.0f), offset * instance_spacing));
+    }
+    if (model.set_up_instance_buffers(&vk_context) != 0) return -1;
+
+    // the extra point lights circle around the y axis inside the bounds of all copies
+    aabb_t scene_bounds;
+    for (const glm::mat4& instance : model.instances)
+    {
+        scene_bounds.grow(glm::vec3(instance * glm::vec4(model_bounds.min, 1.0f)));
+        scene_bounds.grow(glm::vec3(instance * glm::vec4(model_bounds.max, 1.0f)));
+    }
+    glm::vec3 scene_size = scene_bounds.max - scene_bounds.min;
+    // the radius shrinks with the light density so a point is reached by about LIGHT_OVERLAP lights, flat scenes still get some volume
+    float scene_extent = std::max(scene_size.x, std::max(scene_size.y, scene_size.z));
+    glm::vec3 light_volume = glm::max(scene_size, glm::vec3(0.1f * scene_extent));
+    float light_density = std::max(1u, point_light_count) / (light_volume.x * light_volume.y * light_volume.z);
+    float light_radius = std::min(0.25f * scene_extent, std::cbrt(LIGHT_OVERLAP / (light_density * 4.0f / 3.0f * glm::pi<float>())));
+    std::vector<point_light_t> point_lights(point_light_count);
+    std::vector<glm::vec2> light_orbits(point_light_count);
+    std::mt19937 light_random(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (std::uint32_t i = 0; i < point_light_count; ++i)
+    {
+        glm::vec3 position = scene_bounds.min + glm::vec3(unit(light_random), unit(light_random), unit(light_random)) * scene_size;
+        point_lights[i].position = glm::vec4(position, light_radius * (0.5f + unit(light_random)));
+        point_lights[i].color = glm::vec4(glm::vec3(unit(light_random), unit(light_random), unit(light_random)) * 0.5f, 1.0f);
+        light_orbits[i] = glm::vec2(unit(light_random) * 2.0f * glm::pi<float>(), 0.2f + 0.8f * unit(light_random));
+    }
+    glm::vec3 scene_center = (scene_bounds.min + scene_bounds.max) * 0.5f;
+    light_clusters_t light_clusters;
+    if (light_clusters.init(point_light_count, &vk_context) != 0) return -1;
     
-    model_t cube("./models/cube/cube.obj", false);
+    model_t cube("./models/cube/cube.obj", false, true, vk_context.thread_pool);
     if (!cube.is_initialized()) return -1;
     bufs = cube.set_up_buffer(&vk_context);
     if (!bufs.has_value()) return -1;
@@ -302,25 +468,47 @@ int main(int argc, char** argv)
     }
     g_descriptor_config.push_back(std::make_tuple(0, sizeof(ubo_t), &ubo_buffers[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, true));
     g_descriptor_config.push_back(std::make_tuple(7, sizeof(flags_t), &ubo_buffers[MAX_FRAMES_IN_FLIGHT * 2], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, true));
+    g_descriptor_config.push_back(std::make_tuple(8, model.get_instance_count() * sizeof(glm::mat4), &model.instance_buffers[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, true));
     descriptor_config.push_back(std::make_tuple(5, sizeof(view_t), &ubo_buffers[MAX_FRAMES_IN_FLIGHT * 3], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, true));
     forward_descriptor_config.push_back(std::make_tuple(0, sizeof(ubo_t), &ubo_buffers[MAX_FRAMES_IN_FLIGHT], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, true));
     shadow_map_descriptor_config.push_back(std::make_tuple(0, sizeof(shadow_map_t), &ubo_buffers[MAX_FRAMES_IN_FLIGHT * 4], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, true));
+    shadow_map_descriptor_config.push_back(std::make_tuple(1, model.get_instance_count() * sizeof(glm::mat4), &model.instance_buffers[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, true));
 
     image_settings_t image_settings;
     image_settings.format = VK_FORMAT_R8G8B8A8_UNORM;
-    if (vk_context.add_image(albedo_path, image_settings, flip_texture) != 0) return -1;
-    if (vk_context.add_image(specular_path, image_settings, flip_texture) != 0) return -1;
-    if (vk_context.add_image(normal_path, image_settings, flip_texture) != 0) return -1;
-    if (vk_context.add_image(metallic_path, image_settings, flip_texture) != 0) return -1;
-    if (vk_context.add_image(roughness_path, image_settings, flip_texture) != 0) return -1;
-    if (vk_context.add_image(ao_path, image_settings, flip_texture) != 0) return -1;
-    
-    g_descriptor_config.push_back(std::make_tuple(1, 0, &vk_context.images[0], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, false));
-    g_descriptor_config.push_back(std::make_tuple(2, 0, &vk_context.images[1], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, false));
-    g_descriptor_config.push_back(std::make_tuple(3, 0, &vk_context.images[2], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, false));
-    g_descriptor_config.push_back(std::make_tuple(4, 0, &vk_context.images[3], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, false));
-    g_descriptor_config.push_back(std::make_tuple(5, 0, &vk_context.images[4], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, false));
-    g_descriptor_config.push_back(std::make_tuple(6, 0, &vk_context.images[5], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, false));
+    // textures a material does not provide fall back to the command line paths, so every material fills all six g buffer bindings
+    std::vector<material_t> materials = model.materials;
+    if (materials.empty()) materials.push_back({ "default" });
+    std::vector<std::string> texture_paths;
+    std::vector<std::array<std::uint32_t, 6>> material_textures;
+    for (const material_t& material : materials)
+    {
+        std::array<std::string, 6> paths = { material.albedo, material.specular, material.normal, material.metallic, material.roughness, material.ao };
+        std::array<std::string, 6> default_paths = { albedo_path, specular_path, normal_path, metallic_path, roughness_path, ao_path };
+        if (albedo_override) paths[0] = "";
+        std::array<std::uint32_t, 6> textures;
+        for (std::uint32_t i = 0; i < paths.size(); ++i)
+        {
+            const std::string& path = paths[i].empty() ? default_paths[i] : paths[i];
+            auto it = std::find(texture_paths.begin(), texture_paths.end(), path);
+            textures[i] = static_cast<std::uint32_t>(std::distance(texture_paths.begin(), it));
+            if (it == texture_paths.end()) texture_paths.push_back(path);
+        }
+        material_textures.push_back(textures);
+    }
+    if (vk_context.add_images(texture_paths, image_settings, flip_texture) != 0) return -1;
+
+    std::vector<std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>>> material_descriptor_configs;
+    for (const std::array<std::uint32_t, 6>& textures : material_textures)
+    {
+        std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>> config = g_descriptor_config;
+        for (std::uint32_t i = 0; i < textures.size(); ++i)
+        {
+            config.push_back(std::make_tuple(i + 1, 0, &vk_context.images[textures[i]], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, false));
+        }
+        material_descriptor_configs.push_back(config);
+    }
+    g_descriptor_config = material_descriptor_configs[0];
 
     std::vector<buffer_t*> blinn_phong_buffers;
     for (std::uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
@@ -350,254 +538,214 @@ int main(int argc, char** argv)
     VkDescriptorSetLayoutBinding flags_binding = UBO_LAYOUT_BINDING;
     flags_binding.binding = 7;
     flags_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkDescriptorSetLayoutBinding instance_binding = { 8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
     std::vector<VkDescriptorSetLayoutBinding> g_bindings = { UBO_LAYOUT_BINDING, SAMPLER_LAYOUT_BINDING, spec_binding, normal_binding, metallic_binding,
-        roughness_binding, ao_binding, flags_binding};
+        roughness_binding, ao_binding, flags_binding, instance_binding };
 
-    VkDescriptorSetLayoutBinding g_pos_binding = { 0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    VkDescriptorSetLayoutBinding g_depth_binding = { 0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
     VkDescriptorSetLayoutBinding g_normal_binding = { 1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
     VkDescriptorSetLayoutBinding g_albedo_binding = { 2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
     VkDescriptorSetLayoutBinding g_pbr_binding = { 3, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
     VkDescriptorSetLayoutBinding phong_layout_binding = { 4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
     VkDescriptorSetLayoutBinding view_layout_binding = { 5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
     VkDescriptorSetLayoutBinding cube_map_binding = {6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
-    std::vector<VkDescriptorSetLayoutBinding> out_bindings = { g_pos_binding, g_normal_binding, g_albedo_binding, g_pbr_binding, phong_layout_binding, view_layout_binding, cube_map_binding };
+    VkDescriptorSetLayoutBinding cluster_params_binding = { 7, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    VkDescriptorSetLayoutBinding lights_binding = { 8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    VkDescriptorSetLayoutBinding clusters_binding = { 9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    std::vector<VkDescriptorSetLayoutBinding> out_bindings = { g_depth_binding, g_normal_binding, g_albedo_binding, g_pbr_binding, phong_layout_binding, view_layout_binding, cube_map_binding,
+        cluster_params_binding, lights_binding, clusters_binding };
 
     std::vector<VkDescriptorSetLayoutBinding> forward_bindings = { UBO_LAYOUT_BINDING };
     std::vector<VkDescriptorSetLayoutBinding> hdr_bindings = { {0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} };
-    std::vector<VkDescriptorSetLayoutBinding> shadow_map_bindings = { UBO_LAYOUT_BINDING };
+    VkDescriptorSetLayoutBinding shadow_instance_binding = instance_binding;
+    shadow_instance_binding.binding = 1;
+    std::vector<VkDescriptorSetLayoutBinding> shadow_map_bindings = { UBO_LAYOUT_BINDING, shadow_instance_binding };
 
     /* SHADOW MAP RENDER PASS AND PIPELINE */
+    // the shadow map is a depth only cube, the lighting pass compares against it through the sampler
+    std::optional<VkFormat> shadow_format = find_depth_format(&vk_context.physical_device);
+    if (!shadow_format.has_value()) return -1;
     image_settings_t shadow_map_settings;
-    shadow_map_settings.format = VK_FORMAT_R32_SFLOAT;
+    shadow_map_settings.format = shadow_format.value();
     shadow_map_settings.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-    shadow_map_settings.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    shadow_map_settings.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     shadow_map_settings.layer_count = 6;
     image_view_settings_t shadow_map_view_settings = {
         .type = VK_IMAGE_VIEW_TYPE_CUBE,
-        .format = VK_FORMAT_R32_SFLOAT,
+        .format = shadow_format.value(),
+        .aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT,
         .layer_count = 6,
-        .components = { VK_COMPONENT_SWIZZLE_R }
+        .components = {}
     };
     image_t* shadow_map = new image_t(&vk_context.physical_device, &vk_context.command_pool);
     shadow_map->init_color_buffer(shadow_map_settings, { 1024, 1024 }, vk_context.device, shadow_map_view_settings);
     shadow_map->transition_image_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     sampler_settings_t shadow_sampler_settings;
-    shadow_sampler_settings.address_mode = { VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER };
+    shadow_sampler_settings.address_mode = { VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE };
+    shadow_sampler_settings.anisotropy_enable = VK_FALSE;
+    shadow_sampler_settings.compare_enable = VK_TRUE;
+    shadow_sampler_settings.compare_op = VK_COMPARE_OP_LESS_OR_EQUAL;
+    shadow_sampler_settings.mipmap_mode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
     shadow_map->create_image_sampler(shadow_sampler_settings);
-    
-    image_settings_t shadow_depth_settings;
-    shadow_depth_settings.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    shadow_depth_settings.sample_count = VK_SAMPLE_COUNT_1_BIT;
-    image_t* shadow_buffer = new image_t(&vk_context.physical_device, &vk_context.command_pool);
-    shadow_buffer->init_depth_buffer(shadow_depth_settings, { 1024, 1024 }, vk_context.device);
+
+    // with multiview all six faces are rendered in one pass, each view writes the matching layer of the cube
+    bool shadow_multiview = vk_context.device->multiview && !separate_shadow_faces;
+    if (gpu_culling && frustum_culling && !vk_context.device->draw_indirect_count)
+    {
+        std::cerr << "Indirect count draws with per draw instances are not supported, falling back to --cpu-culling." << std::endl;
+    }
+    gpu_culling = gpu_culling && frustum_culling && vk_context.device->draw_indirect_count;
+    std::uint32_t shadow_face_passes = shadow_multiview ? 1 : 6;
 
     render_pass_settings_t shadow_map_pass_settings;
-    shadow_map_pass_settings.add_subpass(VK_FORMAT_R32_SFLOAT, VK_SAMPLE_COUNT_1_BIT, &vk_context.physical_device, 1, 1);
+    shadow_map_pass_settings.add_subpass(shadow_format.value(), VK_SAMPLE_COUNT_1_BIT, &vk_context.physical_device, 0, 1);
+    shadow_map_pass_settings.attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     shadow_map_pass_settings.attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkSubpassDependency shadow_map_read_dependency{};
+    shadow_map_read_dependency.srcSubpass = 0;
+    shadow_map_read_dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    shadow_map_read_dependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    shadow_map_read_dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    shadow_map_read_dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    shadow_map_read_dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    shadow_map_pass_settings.dependencies.push_back(shadow_map_read_dependency);
+    if (shadow_multiview) shadow_map_pass_settings.view_mask = 0b111111;
 
     render_pass_t* shadow_map_pass = new render_pass_t();
     shadow_map_pass->init(shadow_map_pass_settings, vk_context.device->device);
-    std::vector<image_t*> shadow_map_views(6);
-    for (std::uint32_t i = 0; i < 6; ++i)
+    if (shadow_multiview)
+    {
+        image_view_settings_t shadow_map_array_settings = {
+            .type = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+            .image = shadow_map->image,
+            .format = shadow_format.value(),
+            .device = vk_context.device->device,
+            .aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .layer_count = 6,
+            .components = {}
+        };
+        shadow_map->secondary_views.push_back(VK_NULL_HANDLE);
+        shadow_map_array_settings.view = &shadow_map->secondary_views.back();
+        if (create_image_view(shadow_map_array_settings) != 0) return -1;
+    }
+    std::vector<image_t*> shadow_map_views(shadow_face_passes);
+    for (std::uint32_t i = 0; i < shadow_face_passes; ++i)
     {
         image_t* img = (image_t*)malloc(sizeof(image_t));
         shadow_map_views[i] = img;
-        img->view = shadow_map->secondary_views[i];
-        std::vector<framebuffer_attachment_t> shadow_map_attachments = { {&shadow_map_views[i], IMAGE}, {&shadow_buffer, IMAGE} };
+        img->view = shadow_multiview ? shadow_map->secondary_views.back() : shadow_map->secondary_views[i];
+        std::vector<framebuffer_attachment_t> shadow_map_attachments = { {&shadow_map_views[i], IMAGE} };
         shadow_map_pass->add_framebuffer(1024, 1024, shadow_map_attachments);
     }
     shadow_map_pass->resizeable = false;
     vk_context.render_passes.push_back(shadow_map_pass);
 
     vk_context.add_descriptor_set_layout(shadow_map_bindings);
-    pipeline_shaders_t shadow_map_shaders = { "./build/target/shaders/shadow_map.vert.spv", std::nullopt, "./build/target/shaders/shadow_map.frag.spv" };
+    bool packed_vertices = vertex_format != VERTEX_FORMAT_FULL;
+    pipeline_shaders_t shadow_map_shaders = { packed_vertices ? "./build/target/shaders/shadow_map_packed.vert.spv" : "./build/target/shaders/shadow_map.vert.spv",
+        std::nullopt, std::nullopt };
     pipeline_settings_t shadow_map_pipeline_settings;
-    shadow_map_pipeline_settings.populate_defaults(vk_context.get_descriptor_set_layouts(), vk_context.render_passes[0]);
-    shadow_map_pipeline_settings.push_constant_ranges.push_back({ .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(glm::mat4) });
+    shadow_map_pipeline_settings.populate_defaults(vk_context.get_descriptor_set_layouts(), vk_context.render_passes[0], 0, vertex_format);
+    shadow_map_pipeline_settings.rasterizer.depthBiasEnable = VK_TRUE;
+    shadow_map_pipeline_settings.rasterizer.depthBiasConstantFactor = 1.25f;
+    shadow_map_pipeline_settings.rasterizer.depthBiasSlopeFactor = 1.75f;
+    shadow_map_pipeline_settings.push_constant_ranges.push_back({ .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0,
+            .size = static_cast<std::uint32_t>(packed_vertices ? 16 + sizeof(vertex_dequant_t) : 2 * sizeof(std::uint32_t)) });
     if (vk_context.add_pipeline(shadow_map_shaders, shadow_map_pipeline_settings) != 0) return -1;
     
     descriptor_config.push_back(std::make_tuple(6, 0, &shadow_map, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, false));
-
-    /* DEFFERED PBR RENDER PASS AND PIPELINES */
-    std::vector<image_t*> g_buffer;
-    image_settings_t g_buffer_settings;
-    g_buffer_settings.sample_count = VK_SAMPLE_COUNT_1_BIT;
-    g_buffer_settings.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-    g_buffer_settings.usage = VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    // POS
-    g_buffer.push_back(new image_t(&vk_context.physical_device, &vk_context.command_pool));
-    g_buffer.back()->init_color_buffer(g_buffer_settings, vk_context.get_swap_chain_extent(), vk_context.device);
-    g_buffer.back()->transition_image_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    vk_context.color_buffers.push_back(g_buffer.back());
-
-    // NORMAL
-    g_buffer.push_back(new image_t(&vk_context.physical_device, &vk_context.command_pool));
-    g_buffer.back()->init_color_buffer(g_buffer_settings, vk_context.get_swap_chain_extent(), vk_context.device);
-    g_buffer.back()->transition_image_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    vk_context.color_buffers.push_back(g_buffer.back());
-
-    // ALBEDO
-    g_buffer.push_back(new image_t(&vk_context.physical_device, &vk_context.command_pool));
-    g_buffer.back()->init_color_buffer(g_buffer_settings, vk_context.get_swap_chain_extent(), vk_context.device);
-    g_buffer.back()->transition_image_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    vk_context.color_buffers.push_back(g_buffer.back());
- 
-    // PBR
-    g_buffer.push_back(new image_t(&vk_context.physical_device, &vk_context.command_pool));
-    g_buffer.back()->init_color_buffer(g_buffer_settings, vk_context.get_swap_chain_extent(), vk_context.device);
-    g_buffer.back()->transition_image_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    vk_context.color_buffers.push_back(g_buffer.back());
-
-    image_settings_t hdr_buffer_settings;
-    hdr_buffer_settings.sample_count = VK_SAMPLE_COUNT_1_BIT;
-    hdr_buffer_settings.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-    hdr_buffer_settings.usage = VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    image_t* hdr_buffer = new image_t(&vk_context.physical_device, &vk_context.command_pool);
-    hdr_buffer->init_color_buffer(hdr_buffer_settings, vk_context.get_swap_chain_extent(), vk_context.device);
-    hdr_buffer->transition_image_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    vk_context.color_buffers.push_back(hdr_buffer);
-
-    image_settings_t g_depth_settings;
-    g_depth_settings.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    g_depth_settings.sample_count = VK_SAMPLE_COUNT_1_BIT;
-    g_buffer.push_back(new image_t(&vk_context.physical_device, &vk_context.command_pool));
-    g_buffer.back()->init_depth_buffer(g_depth_settings, vk_context.get_swap_chain_extent(), vk_context.device);
-    vk_context.depth_buffers.push_back(g_buffer.back());
-
-    image_t** g_pos = &vk_context.color_buffers[0];
-    descriptor_config.push_back(std::make_tuple(0, 0, g_pos, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
-    image_t** g_normal = &vk_context.color_buffers[1];
-    descriptor_config.push_back(std::make_tuple(1, 0, g_normal, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
-    image_t** g_albedo = &vk_context.color_buffers[2];
-    descriptor_config.push_back(std::make_tuple(2, 0, g_albedo, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
-    image_t** g_pbr = &vk_context.color_buffers[3];
-    descriptor_config.push_back(std::make_tuple(3, 0, g_pbr, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
-    image_t** hdr = &vk_context.color_buffers[4];
-    hdr_descriptor_config.push_back(std::make_tuple(0, 0, hdr, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
-    
-    render_pass_settings_t render_pass_settings;
-    render_pass_settings.add_subpass(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, &vk_context.physical_device, 4, 1, 0);
-    render_pass_settings.add_subpass(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, &vk_context.physical_device, 1, 0, 0, 4);
-    render_pass_settings.add_subpass(VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, &vk_context.physical_device, 1, 1, 0, 0);
-    // remove added color and depth attachments
-    render_pass_settings.attachments.pop_back();
-    render_pass_settings.attachments.pop_back();
-    render_pass_settings.subpasses.back().depth_attachment_reference.back().attachment = 4;
-    render_pass_settings.subpasses.back().color_attachment_references.back().attachment = 5;
-    render_pass_settings.add_subpass(vk_context.swap_chain->format.format, VK_SAMPLE_COUNT_1_BIT, &vk_context.physical_device, 1, 0, 0, 1, 5);
-    render_pass_settings.attachments.back().finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    render_pass_settings.dependencies.clear();
-    VkSubpassDependency dep{};
-    dep.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dep.dstSubpass = 0;
-    dep.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    dep.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    dep.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
-    dep.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
-    dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    render_pass_settings.dependencies.push_back(dep);
-
-    dep = {};
-    dep.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dep.dstSubpass = 0;
-    dep.srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dep.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    render_pass_settings.dependencies.push_back(dep);
-
-    dep = {};
-    dep.srcSubpass = 0;
-    dep.dstSubpass = 1;
-    dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dep.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
-    dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    render_pass_settings.dependencies.push_back(dep);
-
-    dep = {};
-    dep.srcSubpass = 1;
-    dep.dstSubpass = 2;
-    dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-    dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    render_pass_settings.dependencies.push_back(dep);
-
-    dep.srcSubpass = 2;
-    dep.dstSubpass = 3;
-    dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-    dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    render_pass_settings.dependencies.push_back(dep);
-    
-    dep = {};
-    dep.srcSubpass = 0;
-    dep.dstSubpass = 2;
-    dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
-    dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    render_pass_settings.dependencies.push_back(dep);
-
-    dep = {};
-    dep.srcSubpass = 3;
-    dep.dstSubpass = VK_SUBPASS_EXTERNAL;
-    dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dep.dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dep.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    render_pass_settings.dependencies.push_back(dep);
-
-    imgui_add_dependency(4, 6, &vk_context, render_pass_settings);
-
-    render_pass_t* render_pass = new render_pass_t();
-    render_pass->init(render_pass_settings, vk_context.device->device);
-    for (std::uint32_t i = 0; i < vk_context.swap_chain->image_views.size(); ++i)
-    {
-        std::vector<framebuffer_attachment_t> attachments = { {&vk_context.color_buffers[0], IMAGE}, {&vk_context.color_buffers[1], IMAGE},
-            {&vk_context.color_buffers[2], IMAGE}, {&vk_context.color_buffers[3]}, {&vk_context.depth_buffers[0], IMAGE},
-            {&vk_context.color_buffers[4], IMAGE}, {&vk_context.swap_chain, SWAP_CHAIN, i} };
-        render_pass->add_framebuffer(vk_context.swap_chain->extent.width, vk_context.swap_chain->extent.height, attachments);
-    }
-    vk_context.render_passes.push_back(render_pass);
+    for (const auto& config : light_clusters.get_lighting_descriptor_config(7)) descriptor_config.push_back(config);
+
+    /* DEFFERED PBR RENDER GRAPH AND PIPELINES */
+    render_graph_t render_graph;
+    // 12 bytes per pixel besides depth, positions come from the depth buffer and normals are octahedral encoded
+    std::optional<VkFormat> normal_format = find_supported_format({ VK_FORMAT_R16G16_SNORM, VK_FORMAT_R16G16_SFLOAT }, VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT, &vk_context.physical_device);
+    if (!normal_format.has_value()) return -1;
+    render_graph.add_color_resource("g_normal", normal_format.value());
+    render_graph.add_color_resource("g_albedo", VK_FORMAT_R8G8B8A8_SRGB);
+    render_graph.add_color_resource("g_pbr", VK_FORMAT_R8G8B8A8_UNORM);
+    render_graph.add_depth_resource("depth");
+    render_graph.add_color_resource("hdr", VK_FORMAT_R16G16B16A16_SFLOAT);
+    render_graph.add_swap_chain_resource("swap_chain");
+
+    render_graph.add_pass("g_buffer").write_color("g_normal").write_color("g_albedo").write_color("g_pbr").write_depth("depth");
+    render_graph.add_pass("lighting").read_input("depth").read_input("g_normal").read_input("g_albedo").read_input("g_pbr").write_color("hdr");
+    render_graph.add_pass("forward").blend_color("hdr").write_depth("depth");
+    render_graph.add_pass("hdr").read_input("hdr").write_color("swap_chain");
+    render_graph.add_pass("imgui").blend_color("swap_chain").keep();
+    if (render_graph.compile(&vk_context) != 0) return -1;
+    std::optional<std::uint32_t> g_buffer_subpass = render_graph.get_subpass("g_buffer");
+    std::optional<std::uint32_t> lighting_subpass = render_graph.get_subpass("lighting");
+    std::optional<std::uint32_t> forward_subpass = render_graph.get_subpass("forward");
+    std::optional<std::uint32_t> hdr_subpass = render_graph.get_subpass("hdr");
+    std::optional<std::uint32_t> imgui_subpass = render_graph.get_subpass("imgui");
+    if (!g_buffer_subpass.has_value() || !lighting_subpass.has_value() || !forward_subpass.has_value() || !hdr_subpass.has_value() ||
+            !imgui_subpass.has_value()) return -1;
+
+    descriptor_config.push_back(std::make_tuple(0, 0, render_graph.get_image("depth"), VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
+    descriptor_config.push_back(std::make_tuple(1, 0, render_graph.get_image("g_normal"), VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
+    descriptor_config.push_back(std::make_tuple(2, 0, render_graph.get_image("g_albedo"), VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
+    descriptor_config.push_back(std::make_tuple(3, 0, render_graph.get_image("g_pbr"), VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
+    hdr_descriptor_config.push_back(std::make_tuple(0, 0, render_graph.get_image("hdr"), VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, false));
 
     vk_context.add_descriptor_set_layout(g_bindings);
-    pipeline_shaders_t g_shaders = { "./build/target/shaders/g_buffer.vert.spv", std::nullopt, "./build/target/shaders/g_buffer.frag.spv" };
+    pipeline_shaders_t g_shaders = { packed_vertices ? "./build/target/shaders/g_buffer_packed.vert.spv" : "./build/target/shaders/g_buffer.vert.spv",
+        std::nullopt, "./build/target/shaders/g_buffer.frag.spv" };
     pipeline_settings_t g_pipeline_settings;
-    g_pipeline_settings.populate_defaults({ vk_context.get_descriptor_set_layouts()[1] }, vk_context.render_passes[1], 4);
+    g_pipeline_settings.populate_defaults({ vk_context.get_descriptor_set_layouts()[1] }, render_graph.get_render_pass("g_buffer"), 3, vertex_format);
+    g_pipeline_settings.subpass = g_buffer_subpass.value();
+    if (packed_vertices)
+    {
+        g_pipeline_settings.push_constant_ranges.push_back({ .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = sizeof(vertex_dequant_t) });
+    }
     //g_pipeline_settings.multisampling.rasterizationSamples = vk_context.msaa_samples;
     if (vk_context.add_pipeline(g_shaders, g_pipeline_settings) != 0) return -1;
     
     vk_context.add_descriptor_set_layout(out_bindings);
     pipeline_shaders_t shaders = { "./build/target/shaders/main.vert.spv", std::nullopt, "./build/target/shaders/main.frag.spv" };
     pipeline_settings_t pipeline_settings;
-    pipeline_settings.populate_defaults({ vk_context.get_descriptor_set_layouts()[2] }, vk_context.render_passes[1]);
-    pipeline_settings.subpass = 1;
+    pipeline_settings.populate_defaults({ vk_context.get_descriptor_set_layouts()[2] }, render_graph.get_render_pass("lighting"));
+    pipeline_settings.subpass = lighting_subpass.value();
     if (vk_context.add_pipeline(shaders, pipeline_settings) != 0) return -1;
 
     vk_context.add_descriptor_set_layout(forward_bindings);
     pipeline_shaders_t forward_shaders = { "./build/target/shaders/forward.vert.spv", std::nullopt, "./build/target/shaders/forward.frag.spv" };
     pipeline_settings_t forward_pipeline_settings;
-    forward_pipeline_settings.populate_defaults({ vk_context.get_descriptor_set_layouts()[3] }, vk_context.render_passes[1]);
-    forward_pipeline_settings.subpass = 2;
+    forward_pipeline_settings.populate_defaults({ vk_context.get_descriptor_set_layouts()[3] }, render_graph.get_render_pass("forward"));
+    forward_pipeline_settings.subpass = forward_subpass.value();
     if (vk_context.add_pipeline(forward_shaders, forward_pipeline_settings) != 0) return -1;
 
     vk_context.add_descriptor_set_layout(hdr_bindings);
     pipeline_shaders_t hdr_shaders = { "./build/target/shaders/hdr.vert.spv", std::nullopt, "./build/target/shaders/hdr.frag.spv" };
     pipeline_settings_t hdr_pipeline_settings;
-    hdr_pipeline_settings.populate_defaults({ vk_context.get_descriptor_set_layouts()[4] }, vk_context.render_passes[1]);
-    hdr_pipeline_settings.subpass = 3;
+    hdr_pipeline_settings.populate_defaults({ vk_context.get_descriptor_set_layouts()[4] }, render_graph.get_render_pass("hdr"));
+    hdr_pipeline_settings.subpass = hdr_subpass.value();
     if (vk_context.add_pipeline(hdr_shaders, hdr_pipeline_settings) != 0) return -1;
 
+    /* GPU DRIVEN CULLING */
+    indirect_draws_t indirect_draws;
+    std::uint32_t cull_pool = 0;
+    std::uint32_t cull_pipeline = 0;
+    if (gpu_culling)
+    {
+        if (indirect_draws.init(model, &vk_context, shadow_face_passes) != 0) return -1;
+        std::int32_t cull_layout = vk_context.add_descriptor_set_layout(CULL_LAYOUT_BINDINGS);
+        if (cull_layout < 0) return -1;
+        cull_pool = static_cast<std::uint32_t>(vk_context.get_descriptor_pools()->size() - 1);
+        if (vk_context.add_compute_pipeline("./build/target/shaders/cull.comp.spv", static_cast<std::uint32_t>(cull_layout)) != 0) return -1;
+        cull_pipeline = static_cast<std::uint32_t>(vk_context.compute_pipelines.size() - 1);
+        vk_context.get_descriptor_pools()->back()->configure_descriptors(indirect_draws.get_descriptor_config());
+    }
+
+    /* CLUSTERED LIGHTING */
+    std::int32_t light_layout = vk_context.add_descriptor_set_layout(LIGHT_CLUSTER_LAYOUT_BINDINGS);
+    if (light_layout < 0) return -1;
+    std::uint32_t light_pool = static_cast<std::uint32_t>(vk_context.get_descriptor_pools()->size() - 1);
+    if (vk_context.add_compute_pipeline("./build/target/shaders/light_clusters.comp.spv", static_cast<std::uint32_t>(light_layout)) != 0) return -1;
+    std::uint32_t light_pipeline = static_cast<std::uint32_t>(vk_context.compute_pipelines.size() - 1);
+    vk_context.get_descriptor_pools()->back()->configure_descriptors(light_clusters.get_descriptor_config());
+
     std::vector<descriptor_pool_t*> pools = *vk_context.get_descriptor_pools();
     pools[0]->configure_descriptors(shadow_map_descriptor_config);
     pools[1]->configure_descriptors(g_descriptor_config);
@@ -605,190 +753,306 @@ int main(int argc, char** argv)
     pools[3]->configure_descriptors(forward_descriptor_config);
     pools[4]->configure_descriptors(hdr_descriptor_config);
 
-    VkDescriptorPool imgui_pool = imgui_setup(4, &vk_context);
-    ImDrawData* draw_data;
-    static blinn_phong_t blinn_phong = { {0.0f, 0.0f, 1.5f}, {.2f, .2f, .6f}, {.02f, .02f, .06f}, {10.0f, 0.0f, 0.0f}, 0.09f, 0.032f, 100.0f };
-    std::function<void(VkCommandBuffer, std::uint32_t, vulkan_context_t*)> draw_command = [&] (VkCommandBuffer command_buffer, std::uint32_t image_index, vulkan_context_t* context)
+    // material 0 uses the g buffer pipeline's own pool, the others get a pool with the same layout
+    std::vector<std::uint32_t> material_pools = { 1 };
+    for (std::uint32_t i = 1; i < material_descriptor_configs.size(); ++i)
     {
-        VkRenderPassBeginInfo begin_info;
-        for (std::uint32_t i = 0; i < 6; ++i)
+        if (vk_context.add_descriptor_pool(1) != 0) return -1;
+        vk_context.get_descriptor_pools()->back()->configure_descriptors(material_descriptor_configs[i]);
+        material_pools.push_back(static_cast<std::uint32_t>(vk_context.get_descriptor_pools()->size() - 1));
+    }
+
+    VkDescriptorPool imgui_pool = VK_NULL_HANDLE;
+    if (!headless) imgui_pool = imgui_setup(render_graph.get_render_pass("imgui"), imgui_subpass.value(), &vk_context);
+    ImDrawData* draw_data = nullptr;
+    std::vector<draw_range_t> submesh_ranges;
+    for (std::uint32_t i = 0; i < model.submeshes.size(); ++i)
+    {
+        submesh_ranges.push_back({ model.submeshes[i].first_index, model.submeshes[i].index_count, i });
+    }
+    std::vector<draw_range_t> visible_ranges = submesh_ranges;
+    std::vector<draw_range_t> shadow_ranges = submesh_ranges;
+    auto material_of = [&](const draw_range_t& range) { return (range.submesh < model.submeshes.size()) ? model.submeshes[range.submesh].material : 0; };
+    auto sort_by_material = [&](std::vector<draw_range_t>& ranges)
+    {
+        std::stable_sort(ranges.begin(), ranges.end(), [&](const draw_range_t& a, const draw_range_t& b) { return material_of(a) < material_of(b); });
+    };
+    sort_by_material(visible_ranges);
+
+    // instances share one draw, so every submesh uses the finest level any of its instances needs
+    auto select_lods = [&](const glm::mat4& transform, const glm::vec3& eye, float lod_scale)
+    {
+        std::vector<std::uint32_t> lods(model.submeshes.size(), lod_selection ? MAX_LODS : 0);
+        if (!lod_selection) return lods;
+        for (std::uint32_t i = 0; i < model.get_instance_count(); ++i)
         {
-            glm::mat4 view_mat = glm::mat4(1.0f);
-            switch (i)
+            glm::vec3 local_eye = glm::vec3(glm::inverse(transform * model.instances[i]) * glm::vec4(eye, 1.0f));
+            for (std::uint32_t s = 0; s < model.submeshes.size(); ++s)
             {
-                case 0: // POSITIVE_X
-                    view_mat = glm::lookAt(blinn_phong.light_pos, blinn_phong.light_pos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-                    break;
-                case 1:	// NEGATIVE_X
-                    view_mat = glm::lookAt(blinn_phong.light_pos, blinn_phong.light_pos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-                    break;
-                case 2:	// POSITIVE_Y
-                    view_mat = glm::lookAt(blinn_phong.light_pos, blinn_phong.light_pos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
-                    break;
-                case 3:	// NEGATIVE_Y
-                    view_mat = glm::lookAt(blinn_phong.light_pos, blinn_phong.light_pos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-                    break;
-                case 4:	// POSITIVE_Z
-                    view_mat = glm::lookAt(blinn_phong.light_pos, blinn_phong.light_pos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-                    break;
-                case 5:	// NEGATIVE_Z
-                    view_mat = glm::lookAt(blinn_phong.light_pos, blinn_phong.light_pos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-                    break;
+                lods[s] = std::min(lods[s], select_lod(model.submeshes[s], local_eye, lod_scale));
             }
-
-            VkRenderPassBeginInfo begin_info = populate_render_pass_begin_info(context->render_passes[0]->render_pass, context->render_passes[0]->framebuffers[i].framebuffer,
-                    {1024, 1024}, CLEAR_COLORS);
-            vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        }
+        return lods;
+    };
+    // the simplified levels are not split into clusters, a visible submesh on a coarser level is drawn whole
+    auto apply_lods = [&](std::vector<draw_range_t>& ranges, const std::vector<std::uint32_t>& lods)
+    {
+        std::vector<draw_range_t> lod_ranges;
+        std::vector<bool> emitted(model.submeshes.size(), false);
+        for (const draw_range_t& range : ranges)
+        {
+            if (range.submesh >= model.submeshes.size() || lods[range.submesh] == 0)
             {
-
-                vkCmdPushConstants(command_buffer,
-                        context->graphics_pipelines[0]->pipeline_layout,
-                        VK_SHADER_STAGE_VERTEX_BIT,
-                        0, sizeof(glm::mat4),
-                        &view_mat);
-
-                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context->graphics_pipelines[0]->pipeline);
-                context->current_pipeline = context->graphics_pipelines[0];
-                VkViewport viewport{};
-                viewport.x = 0.0f;
-                viewport.y = 0.0f;
-                viewport.width = static_cast<float>(1024);
-                viewport.height = static_cast<float>(1024);
-                viewport.minDepth = 0.0f;
-                viewport.maxDepth = 1.0f;
-                vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-                VkRect2D scissor{};
-                scissor.offset = { 0, 0 };
-                scissor.extent = { 1024, 1024 };
-                vkCmdSetScissor(command_buffer, 0, 1, &scissor);
-
-                VkBuffer vertex_buffers[] = { g_vertex_buffer->buffer };
-                VkDeviceSize offsets[] = { 0 };
-                vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
-                vkCmdBindIndexBuffer(command_buffer, g_index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-                context->bind_descriptor_sets(command_buffer, 1, 0);
-
-                vkCmdDrawIndexed(command_buffer, static_cast<std::uint32_t>(model.indices.size()), 1, 0, 0, 0);
+                lod_ranges.push_back(range);
             }
-            vkCmdEndRenderPass(command_buffer);
+            else if (!emitted[range.submesh])
+            {
+                const mesh_lod_t& lod = model.submeshes[range.submesh].lods[lods[range.submesh]];
+                lod_ranges.push_back({ lod.first_index, lod.index_count, range.submesh });
+                emitted[range.submesh] = true;
+            }
+        }
+        ranges.swap(lod_ranges);
+    };
+    static blinn_phong_t blinn_phong = { {0.0f, 0.0f, 1.5f}, {.2f, .2f, .6f}, {.02f, .02f, .06f}, {10.0f, 0.0f, 0.0f}, 0.09f, 0.032f, 100.0f, 0.1f };
+    auto set_viewport = [](VkCommandBuffer command_buffer, VkExtent2D extent)
+    {
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = { 0, 0 };
+        scissor.extent = extent;
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    };
+
+    shadow_cache_t shadow_cache;
+    shadow_cache.enabled = shadow_cache_enabled;
+    std::vector<glm::vec3> model_positions;
+    model_positions.reserve(model.vertices.size());
+    for (const vertex_t& vertex : model.vertices) model_positions.push_back(vertex.pos);
+    shadow_caster_t model_caster = calculate_bounding_sphere(model_positions);
+    // submeshes get the sphere around their bounds so each face only draws the submeshes that reach into it
+    std::vector<shadow_caster_t> submesh_casters(model.submeshes.size());
+    for (std::uint32_t i = 0; i < model.submeshes.size(); ++i)
+    {
+        const aabb_t& bounds = model.submeshes[i].bounds;
+        if (model.submeshes[i].index_count == 0) continue;
+        submesh_casters[i].center = (bounds.min + bounds.max) * 0.5f;
+        submesh_casters[i].radius = glm::length(bounds.max - bounds.min) * 0.5f;
+    }
+    std::vector<std::uint32_t> submesh_caster_faces(model.submeshes.size(), SHADOW_ALL_FACES);
+    std::uint32_t shadow_dirty_faces = SHADOW_ALL_FACES;
+    std::uint32_t shadow_caster_faces = SHADOW_ALL_FACES;
+
+    std::function<void(VkCommandBuffer, std::uint32_t, vulkan_context_t*)> draw_command = [&] (VkCommandBuffer command_buffer, std::uint32_t image_index, vulkan_context_t* context)
+    {
+        // cached faces keep their content, a multiview pass always re-renders the whole cube
+        std::vector<std::uint32_t> shadow_passes;
+        for (std::uint32_t i = 0; i < shadow_face_passes; ++i)
+        {
+            std::uint32_t faces = shadow_multiview ? SHADOW_ALL_FACES : 1u << i;
+            if ((shadow_dirty_faces & faces) != 0) shadow_passes.push_back(i);
         }
 
-        begin_info = populate_render_pass_begin_info(context->render_passes[1]->render_pass, context->render_passes[1]->framebuffers[image_index].framebuffer,
-                context->get_swap_chain_extent(), G_CLEAR_COLORS);
-        vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        // profiler scopes are reserved here in submission order, the secondary buffers only write the timestamps
+        std::uint32_t cull_scope = gpu_culling ? context->profiler->add_scope("cull") : INVALID_SCOPE;
+        std::uint32_t light_scope = context->profiler->add_scope("light_binning");
+        std::vector<std::uint32_t> shadow_scopes(shadow_passes.size());
+        for (std::uint32_t i = 0; i < shadow_passes.size(); ++i)
         {
-            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context->graphics_pipelines[1]->pipeline);
-            context->current_pipeline = context->graphics_pipelines[1];
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(context->get_swap_chain_extent().width);
-            viewport.height = static_cast<float>(context->get_swap_chain_extent().height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+            shadow_scopes[i] = context->profiler->add_scope(shadow_multiview ? "shadow" : "shadow_face_" + std::to_string(shadow_passes[i]));
+        }
+        std::uint32_t g_buffer_scope = context->profiler->add_scope("g_buffer");
+        std::uint32_t lighting_scope = context->profiler->add_scope("lighting");
+        std::uint32_t forward_scope = context->profiler->add_scope("forward");
+        std::uint32_t hdr_scope = context->profiler->add_scope("hdr");
+        std::uint32_t imgui_scope = context->profiler->add_scope("imgui");
+
+        std::vector<secondary_recording_t> recordings;
+        for (std::uint32_t i : shadow_passes)
+        {
+            recordings.push_back({ context->render_passes[0]->render_pass, 0, context->render_passes[0]->framebuffers[i].framebuffer,
+                [&, i] (VkCommandBuffer secondary)
+                {
+                    // faces without casters are only cleared by the render pass
+                    std::uint32_t faces = shadow_multiview ? SHADOW_ALL_FACES : 1u << i;
+                    if ((shadow_caster_faces & faces) == 0) return;
+
+                    context->bind_pipeline(secondary, 0);
+                    std::uint32_t face_constants[] = { i, shadow_caster_faces };
+                    vkCmdPushConstants(secondary,
+                            context->graphics_pipelines[0]->pipeline_layout,
+                            VK_SHADER_STAGE_VERTEX_BIT,
+                            0, sizeof(face_constants),
+                            face_constants);
+                    if (model.vertex_format != VERTEX_FORMAT_FULL)
+                    {
+                        vkCmdPushConstants(secondary, context->graphics_pipelines[0]->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                                16, sizeof(vertex_dequant_t), &model.dequant);
+                    }
+                    set_viewport(secondary, { 1024, 1024 });
+
+                    VkBuffer vertex_buffers[] = { g_vertex_buffer->buffer };
+                    VkDeviceSize offsets[] = { 0 };
+                    vkCmdBindVertexBuffers(secondary, 0, 1, vertex_buffers, offsets);
+                    vkCmdBindIndexBuffer(secondary, g_index_buffer->buffer, 0, model.index_type);
+
+                    if (gpu_culling)
+                    {
+                        indirect_draws.draw_shadow(secondary, context->get_current_frame(), i);
+                    }
+                    else
+                    {
+                        for (const draw_range_t& range : shadow_ranges)
+                        {
+                            if (range.submesh < submesh_caster_faces.size() && (submesh_caster_faces[range.submesh] & faces) == 0) continue;
+                            vkCmdDrawIndexed(secondary, range.index_count, model.get_instance_count(), range.first_index, 0, 0);
+                        }
+                    }
+                } });
+        }
 
-            VkRect2D scissor{};
-            scissor.offset = { 0, 0 };
-            scissor.extent = context->get_swap_chain_extent();
-            vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+        VkRenderPass main_pass = render_graph.get_render_pass("g_buffer")->render_pass;
+        VkFramebuffer main_framebuffer = render_graph.get_render_pass("g_buffer")->framebuffers[image_index].framebuffer;
+        recordings.push_back({ main_pass, g_buffer_subpass.value(), main_framebuffer, [&] (VkCommandBuffer secondary)
+        {
+            context->profiler->begin_scope(secondary, g_buffer_scope);
+            context->bind_pipeline(secondary, 1);
+            if (model.vertex_format != VERTEX_FORMAT_FULL)
+            {
+                vkCmdPushConstants(secondary, context->graphics_pipelines[1]->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                        0, sizeof(vertex_dequant_t), &model.dequant);
+            }
+            set_viewport(secondary, context->get_swap_chain_extent());
 
             VkBuffer vertex_buffers[] = { g_vertex_buffer->buffer };
             VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
-            vkCmdBindIndexBuffer(command_buffer, g_index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-            context->bind_descriptor_sets(command_buffer, 1, 0);
+            vkCmdBindVertexBuffers(secondary, 0, 1, vertex_buffers, offsets);
+            vkCmdBindIndexBuffer(secondary, g_index_buffer->buffer, 0, model.index_type);
 
-            vkCmdDrawIndexed(command_buffer, static_cast<std::uint32_t>(model.indices.size()), 1, 0, 0, 0);
-        }
+            if (gpu_culling)
+            {
+                // one indirect count draw per material region, the compute pass already wrote the visible clusters
+                for (std::uint32_t material = 0; material < indirect_draws.get_material_count(); ++material)
+                {
+                    if (material != 0 && material < material_pools.size()) context->bind_descriptor_pool(secondary, 1, material_pools[material]);
+                    indirect_draws.draw_material(secondary, context->get_current_frame(), material);
+                }
+                context->profiler->end_scope(secondary, g_buffer_scope);
+                return;
+            }
 
-        vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+            // bind_pipeline bound material 0, ranges are sorted by material so each set is bound at most once
+            std::uint32_t bound_material = 0;
+            for (const draw_range_t& range : visible_ranges)
+            {
+                std::uint32_t material = material_of(range);
+                if (material != bound_material && material < material_pools.size())
+                {
+                    context->bind_descriptor_pool(secondary, 1, material_pools[material]);
+                    bound_material = material;
+                }
+                vkCmdDrawIndexed(secondary, range.index_count, model.get_instance_count(), range.first_index, 0, 0);
+            }
+            context->profiler->end_scope(secondary, g_buffer_scope);
+        } });
 
+        recordings.push_back({ main_pass, lighting_subpass.value(), main_framebuffer, [&] (VkCommandBuffer secondary)
         {
-            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context->graphics_pipelines[2]->pipeline);
-            context->current_pipeline = context->graphics_pipelines[2];
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(context->get_swap_chain_extent().width);
-            viewport.height = static_cast<float>(context->get_swap_chain_extent().height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-            VkRect2D scissor{};
-            scissor.offset = { 0, 0 };
-            scissor.extent = context->get_swap_chain_extent();
-            vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+            context->profiler->begin_scope(secondary, lighting_scope);
+            context->bind_pipeline(secondary, 2);
+            set_viewport(secondary, context->get_swap_chain_extent());
 
             VkBuffer vertex_buffers[] = { vertex_buffer->buffer };
             VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
-            vkCmdBindIndexBuffer(command_buffer, index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-            context->bind_descriptor_sets(command_buffer, 2, 0);
+            vkCmdBindVertexBuffers(secondary, 0, 1, vertex_buffers, offsets);
+            vkCmdBindIndexBuffer(secondary, index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
 
-            vkCmdDrawIndexed(command_buffer, static_cast<std::uint32_t>(indices.size()), 1, 0, 0, 0);
-        }
-
-        vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdDrawIndexed(secondary, static_cast<std::uint32_t>(indices.size()), 1, 0, 0, 0);
+            context->profiler->end_scope(secondary, lighting_scope);
+        } });
 
+        recordings.push_back({ main_pass, forward_subpass.value(), main_framebuffer, [&] (VkCommandBuffer secondary)
         {
-            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context->graphics_pipelines[3]->pipeline);
-            context->current_pipeline = context->graphics_pipelines[3];
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(context->get_swap_chain_extent().width);
-            viewport.height = static_cast<float>(context->get_swap_chain_extent().height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-            VkRect2D scissor{};
-            scissor.offset = { 0, 0 };
-            scissor.extent = context->get_swap_chain_extent();
-            vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+            context->profiler->begin_scope(secondary, forward_scope);
+            context->bind_pipeline(secondary, 3);
+            set_viewport(secondary, context->get_swap_chain_extent());
 
             VkBuffer vertex_buffers[] = { forward_vertex_buffer->buffer };
             VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
-            vkCmdBindIndexBuffer(command_buffer, forward_index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-            context->bind_descriptor_sets(command_buffer, 3, 0);
-            
-            vkCmdDrawIndexed(command_buffer, static_cast<std::uint32_t>(cube.indices.size()), 1, 0, 0, 0);
-        }
+            vkCmdBindVertexBuffers(secondary, 0, 1, vertex_buffers, offsets);
+            vkCmdBindIndexBuffer(secondary, forward_index_buffer->buffer, 0, cube.index_type);
 
-        vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdDrawIndexed(secondary, static_cast<std::uint32_t>(cube.indices.size()), 1, 0, 0, 0);
+            context->profiler->end_scope(secondary, forward_scope);
+        } });
 
+        recordings.push_back({ main_pass, hdr_subpass.value(), main_framebuffer, [&] (VkCommandBuffer secondary)
         {
-            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context->graphics_pipelines[4]->pipeline);
-            context->current_pipeline = context->graphics_pipelines[4];
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(context->get_swap_chain_extent().width);
-            viewport.height = static_cast<float>(context->get_swap_chain_extent().height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-            VkRect2D scissor{};
-            scissor.offset = { 0, 0 };
-            scissor.extent = context->get_swap_chain_extent();
-            vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+            context->profiler->begin_scope(secondary, hdr_scope);
+            context->bind_pipeline(secondary, 4);
+            set_viewport(secondary, context->get_swap_chain_extent());
 
             VkBuffer vertex_buffers[] = { vertex_buffer->buffer };
             VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
-            vkCmdBindIndexBuffer(command_buffer, index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
-            context->bind_descriptor_sets(command_buffer, 4, 0);
+            vkCmdBindVertexBuffers(secondary, 0, 1, vertex_buffers, offsets);
+            vkCmdBindIndexBuffer(secondary, index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
 
-            vkCmdDrawIndexed(command_buffer, static_cast<std::uint32_t>(indices.size()), 1, 0, 0, 0);
+            vkCmdDrawIndexed(secondary, static_cast<std::uint32_t>(indices.size()), 1, 0, 0, 0);
+            context->profiler->end_scope(secondary, hdr_scope);
+        } });
+
+        recordings.push_back({ main_pass, imgui_subpass.value(), main_framebuffer, [&] (VkCommandBuffer secondary)
+        {
+            context->profiler->begin_scope(secondary, imgui_scope);
+            if (draw_data != nullptr) ImGui_ImplVulkan_RenderDrawData(draw_data, secondary);
+            context->profiler->end_scope(secondary, imgui_scope);
+        } });
+
+        std::optional<std::vector<VkCommandBuffer>> secondaries = context->record_secondary(recordings);
+        if (!secondaries.has_value())
+        {
+            return;
+        }
+
+        if (gpu_culling)
+        {
+            context->profiler->begin_scope(command_buffer, cull_scope);
+            indirect_draws.record_cull(command_buffer, context->get_current_frame(), context, cull_pipeline, cull_pool);
+            context->profiler->end_scope(command_buffer, cull_scope);
         }
+        context->profiler->begin_scope(command_buffer, light_scope);
+        light_clusters.record_binning(command_buffer, context, light_pipeline, light_pool);
+        context->profiler->end_scope(command_buffer, light_scope);
 
-        vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
-        ImGui_ImplVulkan_RenderDrawData(draw_data, command_buffer);
+        VkRenderPassBeginInfo begin_info;
+        for (std::uint32_t i = 0; i < shadow_passes.size(); ++i)
+        {
+            begin_info = populate_render_pass_begin_info(context->render_passes[0]->render_pass, context->render_passes[0]->framebuffers[shadow_passes[i]].framebuffer,
+                    {1024, 1024}, { CLEAR_COLORS[1] });
+            context->profiler->begin_scope(command_buffer, shadow_scopes[i]);
+            vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            vkCmdExecuteCommands(command_buffer, 1, &secondaries.value()[i]);
+            vkCmdEndRenderPass(command_buffer);
+            context->profiler->end_scope(command_buffer, shadow_scopes[i]);
+        }
+        // the faces only count as rendered once their passes are in the command buffer, a failed or skipped frame leaves them dirty
+        shadow_cache.commit(shadow_dirty_faces);
+
+        begin_info = populate_render_pass_begin_info(main_pass, main_framebuffer, context->get_swap_chain_extent(), render_graph.get_clear_values("g_buffer"));
+        vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        for (std::uint32_t i = shadow_passes.size(); i < secondaries.value().size(); ++i)
+        {
+            if (i != shadow_passes.size()) vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            vkCmdExecuteCommands(command_buffer, 1, &secondaries.value()[i]);
+        }
         vkCmdEndRenderPass(command_buffer);
     };
 
@@ -797,18 +1061,34 @@ int main(int argc, char** argv)
         float delta_time = 0.0f;
         float last_frame = 0.0f;
         bool running = true;
-        while (running && !glfwWindowShouldClose(vk_context.window))
-        {
-            glfwPollEvents();
-            float current_frame = glfwGetTime();
-            delta_time = current_frame - last_frame;
-            last_frame = current_frame;
+        std::uint32_t frames_rendered = 0;
+        bool fixed_frames = headless || benchmark;
+
+        camera_path_t camera_path;
+        camera_path.frame_count = frame_count;
+        benchmark_t benchmark_results(std::min<std::uint32_t>(frame_count / 10, 32));
 
-            if (glfwGetKey(vk_context.window, GLFW_KEY_ESCAPE) == GLFW_PRESS) running = false;//glfwWindowShouldClose(vk_context.window);
-            if (glfwGetKey(vk_context.window, GLFW_KEY_W) == GLFW_PRESS) cam.move(FORWARD, delta_time);
-            if (glfwGetKey(vk_context.window, GLFW_KEY_A) == GLFW_PRESS) cam.move(LEFT, delta_time);
-            if (glfwGetKey(vk_context.window, GLFW_KEY_S) == GLFW_PRESS) cam.move(BACKWARD, delta_time);
-            if (glfwGetKey(vk_context.window, GLFW_KEY_D) == GLFW_PRESS) cam.move(RIGHT, delta_time);
+        while (running && ((fixed_frames) ? frames_rendered < frame_count : !glfwWindowShouldClose(vk_context.window)))
+        {
+            std::chrono::time_point frame_start = std::chrono::high_resolution_clock::now();
+            if (benchmark)
+            {
+                if (!headless) glfwPollEvents();
+                camera_path.apply(cam, blinn_phong.light_pos, frames_rendered);
+            }
+            else if (!headless)
+            {
+                glfwPollEvents();
+                float current_frame = glfwGetTime();
+                delta_time = current_frame - last_frame;
+                last_frame = current_frame;
+
+                if (glfwGetKey(vk_context.window, GLFW_KEY_ESCAPE) == GLFW_PRESS) running = false;//glfwWindowShouldClose(vk_context.window);
+                if (glfwGetKey(vk_context.window, GLFW_KEY_W) == GLFW_PRESS) cam.move(FORWARD, delta_time);
+                if (glfwGetKey(vk_context.window, GLFW_KEY_A) == GLFW_PRESS) cam.move(LEFT, delta_time);
+                if (glfwGetKey(vk_context.window, GLFW_KEY_S) == GLFW_PRESS) cam.move(BACKWARD, delta_time);
+                if (glfwGetKey(vk_context.window, GLFW_KEY_D) == GLFW_PRESS) cam.move(RIGHT, delta_time);
+            }
 
             static std::chrono::time_point start_time = std::chrono::high_resolution_clock::now();
             std::chrono::time_point current_time = std::chrono::high_resolution_clock::now();
@@ -819,9 +1099,33 @@ int main(int argc, char** argv)
             static float time = 0.0f;
             ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(time), glm::vec3(0.0f, 1.0f, 0.0f));
             ubo.view =  cam.calculate_view_matrix();
-            ubo.projection = glm::perspective(glm::radians(cam.fov_angle), vk_context.get_swap_chain_extent().width / (float) vk_context.get_swap_chain_extent().height, 0.1f, 100.0f);
+            ubo.projection = glm::perspective(glm::radians(cam.fov_angle), vk_context.get_swap_chain_extent().width / (float) vk_context.get_swap_chain_extent().height, cam.near_plane, cam.far_plane);
             ubo.projection[1][1] *= -1;
             std::memcpy(ubo_buffers[vk_context.get_current_frame()]->mapped_memory, &ubo, sizeof(ubo_t));
+            if (gpu_culling)
+            {
+                indirect_draws.update(vk_context.get_current_frame(), ubo.projection * ubo.view * ubo.model, ubo.model, blinn_phong.light_pos, blinn_phong.far_plane,
+                        cam.position, lod_selection ? get_lod_scale(cam.fov_angle, static_cast<float>(vk_context.get_swap_chain_extent().height)) : 0.0f,
+                        lod_selection ? get_lod_scale(90.0f, 1024.0f) : 0.0f);
+            }
+            else
+            {
+                // the bvh covers a single copy, instanced models draw whole submeshes unless they are culled on the gpu
+                visible_ranges = (frustum_culling && model.get_instance_count() == 1) ? model.bvh.cull(extract_frustum(ubo.projection * ubo.view * ubo.model)) : submesh_ranges;
+                apply_lods(visible_ranges, select_lods(ubo.model, cam.position, get_lod_scale(cam.fov_angle, static_cast<float>(vk_context.get_swap_chain_extent().height))));
+                sort_by_material(visible_ranges);
+            }
+            static float light_angle = 0.0f;
+            light_angle += 0.01f;
+            for (std::uint32_t i = 0; i < point_lights.size(); ++i)
+            {
+                glm::vec3 offset = glm::vec3(point_lights[i].position) - scene_center;
+                float distance = glm::length(glm::vec2(offset.x, offset.z));
+                float angle = light_orbits[i].x + light_angle * light_orbits[i].y;
+                point_lights[i].position = glm::vec4(scene_center.x + distance * std::cos(angle), point_lights[i].position.y, scene_center.z + distance * std::sin(angle), point_lights[i].position.w);
+            }
+            light_clusters.check_overflow(vk_context.get_current_frame());
+            light_clusters.update(vk_context.get_current_frame(), ubo.view, ubo.projection, vk_context.get_swap_chain_extent(), cam.near_plane, cam.far_plane, point_lights);
             ubo.model = glm::translate(glm::mat4(1.0f), blinn_phong.light_pos);
             ubo.model = glm::scale(ubo.model, glm::vec3(scale, scale, scale));
             std::memcpy(ubo_buffers[MAX_FRAMES_IN_FLIGHT + vk_context.get_current_frame()]->mapped_memory, &ubo, sizeof(ubo_t));
@@ -830,21 +1134,55 @@ int main(int argc, char** argv)
             static view_t view;
             view.pos = cam.position;
             view.mat = ubo.view;
+            view.inverse_view_projection = glm::inverse(ubo.projection * ubo.view);
+            view.extent = glm::vec2(static_cast<float>(vk_context.get_swap_chain_extent().width), static_cast<float>(vk_context.get_swap_chain_extent().height));
             std::memcpy(ubo_buffers[3 * MAX_FRAMES_IN_FLIGHT + vk_context.get_current_frame()]->mapped_memory, &view, sizeof(view_t));
             static shadow_map_t shadow_map_ubo;
             shadow_map_ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(time), glm::vec3(0.0f, 1.0f, 0.0f));
             shadow_map_ubo.view = glm::lookAt(blinn_phong.light_pos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            shadow_map_ubo.projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, blinn_phong.far_plane);
+            shadow_map_ubo.projection = glm::perspective(glm::radians(90.0f), 1.0f, blinn_phong.near_plane, blinn_phong.far_plane);
             shadow_map_ubo.projection[1][1] *= -1;
             shadow_map_ubo.light_pos = blinn_phong.light_pos;
+            if (!gpu_culling)
+            {
+                // every cube face covers 90 degrees of the 1024 texel shadow map
+                shadow_ranges = submesh_ranges;
+                apply_lods(shadow_ranges, select_lods(shadow_map_ubo.model, blinn_phong.light_pos, get_lod_scale(90.0f, 1024.0f)));
+            }
+            for (std::uint32_t i = 0; i < 6; ++i)
+            {
+                shadow_map_ubo.face_views[i] = cube_face_view(blinn_phong.light_pos, i);
+            }
             std::memcpy(ubo_buffers[4 * MAX_FRAMES_IN_FLIGHT + vk_context.get_current_frame()]->mapped_memory, &shadow_map_ubo, sizeof(shadow_map_t));
+            std::vector<shadow_caster_t> casters;
+            shadow_caster_faces = 0;
+            for (std::uint32_t i = 0; i < model.get_instance_count(); ++i)
+            {
+                model_caster.transform = shadow_map_ubo.model * model.instances[i];
+                casters.push_back(model_caster);
+                shadow_caster_faces |= get_caster_faces(blinn_phong.light_pos, blinn_phong.far_plane, model_caster);
+            }
+            if (!gpu_culling)
+            {
+                for (std::uint32_t s = 0; s < submesh_casters.size(); ++s)
+                {
+                    submesh_caster_faces[s] = 0;
+                    for (std::uint32_t i = 0; i < model.get_instance_count(); ++i)
+                    {
+                        submesh_casters[s].transform = shadow_map_ubo.model * model.instances[i];
+                        submesh_caster_faces[s] |= get_caster_faces(blinn_phong.light_pos, blinn_phong.far_plane, submesh_casters[s]);
+                    }
+                }
+            }
+            shadow_dirty_faces = shadow_cache.update(blinn_phong.light_pos, blinn_phong.far_plane, casters);
 
-            ImGui_ImplVulkan_NewFrame();
-            ImGui_ImplGlfw_NewFrame();
-            ImGui::NewFrame();
-
-            //ImGui::ShowDemoWindow();
+            if (!headless)
             {
+                ImGui_ImplVulkan_NewFrame();
+                ImGui_ImplGlfw_NewFrame();
+                ImGui::NewFrame();
+
+                //ImGui::ShowDemoWindow();
                 ImGuiIO& io = ImGui::GetIO();
                 ImGui::Begin("Settings");
                 ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
@@ -853,28 +1191,84 @@ int main(int argc, char** argv)
                 ImGui::SliderFloat("rotation", &time, 0.0f, 360.0f);
                 ImGui::ColorEdit3("light color", &blinn_phong.light_color.r, ImGuiColorEditFlags_HDR | ImGuiColorEditFlags_Float);
                 ImGui::ColorEdit3("ambient light color", &blinn_phong.ambient_color.r, ImGuiColorEditFlags_HDR | ImGuiColorEditFlags_Float);
+                if (vk_context.profiler->enabled && ImGui::CollapsingHeader("GPU timings"))
+                {
+                    double total = 0.0;
+                    for (const std::pair<std::string, double>& scope : vk_context.profiler->get_results())
+                    {
+                        ImGui::Text("%-16s %.3f ms", scope.first.c_str(), scope.second);
+                        total += scope.second;
+                    }
+                    ImGui::Text("%-16s %.3f ms", "total", total);
+                }
+                if (ImGui::CollapsingHeader("Device memory"))
+                {
+                    memory_statistics_t stats = vk_context.device->memory_allocator->get_statistics();
+                    ImGui::Text("blocks:      %u (+%u dedicated)", stats.block_count, stats.dedicated_count);
+                    ImGui::Text("allocations: %u", stats.allocation_count);
+                    ImGui::Text("used:        %.2f / %.2f MiB", stats.bytes_used / (1024.0 * 1024.0), stats.bytes_reserved / (1024.0 * 1024.0));
+                }
                 ImGui::End();
+
+                ImGui::Render();
+                draw_data = ImGui::GetDrawData();
             }
 
             std::memcpy(blinn_phong_buffers[vk_context.get_current_frame()]->mapped_memory, &blinn_phong, sizeof(blinn_phong_t));
 
-            ImGui::Render();
-            draw_data = ImGui::GetDrawData();
-
+            vk_context.profiler->frame_tag = frames_rendered;
             if (vk_context.draw_frame(draw_command) != 0)
             {
                 break;
             }
+
+            if (benchmark)
+            {
+                std::chrono::time_point frame_end = std::chrono::high_resolution_clock::now();
+                frame_sample_t sample;
+                sample.frame = frames_rendered;
+                sample.frame_ms = std::chrono::duration<double, std::milli>(frame_end - frame_start).count();
+                sample.fence_wait_ms = vk_context.frame_timings.fence_wait_ms;
+                sample.record_ms = vk_context.frame_timings.record_ms;
+                sample.submit_ms = vk_context.frame_timings.submit_ms;
+                sample.present_ms = vk_context.frame_timings.present_ms;
+                benchmark_results.add_sample(sample);
+                // the resolved timings belong to the frame recorded frames_in_flight frames ago
+                std::optional<std::uint32_t> gpu_frame = vk_context.profiler->get_results_tag();
+                if (gpu_frame.has_value()) benchmark_results.add_gpu_timings(gpu_frame.value(), vk_context.profiler->get_results());
+            }
+            ++frames_rendered;
+        }
+
+        if (benchmark)
+        {
+            vkDeviceWaitIdle(vk_context.device->device);
+            for (const auto& timings : vk_context.profiler->drain()) benchmark_results.add_gpu_timings(timings.first, timings.second);
+            benchmark_results.print_summary();
+            benchmark_results.write_csv(benchmark_path + ".csv");
+            benchmark_results.write_json(benchmark_path + ".json");
+        }
+
+        if (headless && !output_path.empty() && frames_rendered > 0)
+        {
+            std::vector<std::uint8_t> pixels;
+            if (vk_context.read_back_frame(pixels) == 0)
+            {
+                write_ppm(output_path, pixels, vk_context.get_swap_chain_extent().width, vk_context.get_swap_chain_extent().height,
+                        vk_context.swap_chain->format.format);
+            }
         }
     });
 
     for (image_t* img : shadow_map_views) free(img);
-    delete shadow_buffer;
     delete shadow_map;
-    vkDestroyDescriptorPool(vk_context.device->device, imgui_pool, nullptr);
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (!headless)
+    {
+        vkDestroyDescriptorPool(vk_context.device->device, imgui_pool, nullptr);
+        ImGui_ImplVulkan_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,208 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void aabb_t::grow(const glm::vec3& point)
+{
+    this->min = glm::min(this->min, point);
+    this->max = glm::max(this->max, point);
+}
+
+void aabb_t::grow(const aabb_t& other)
+{
+    this->min = glm::min(this->min, other.min);
+    this->max = glm::max(this->max, other.max);
+}
+
+frustum_t extract_frustum(const glm::mat4& matrix)
+{
+    // Gribb/Hartmann, rows of the matrix combined for a [0, 1] depth range
+    glm::vec4 row_x = glm::vec4(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+    glm::vec4 row_y = glm::vec4(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+    glm::vec4 row_z = glm::vec4(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+    glm::vec4 row_w = glm::vec4(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+    glm::vec4 planes[6] = { row_w + row_x, row_w - row_x, row_w + row_y, row_w - row_y, row_z, row_w - row_z };
+
+    frustum_t frustum;
+    for (std::uint32_t i = 0; i < 8; ++i)
+    {
+        // the padding planes accept everything
+        glm::vec4 plane = (i < 6) ? planes[i] / glm::length(glm::vec3(planes[i])) : glm::vec4(0.0f, 0.0f, 0.0f, std::numeric_limits<float>::max());
+        frustum.nx[i] = plane.x;
+        frustum.ny[i] = plane.y;
+        frustum.nz[i] = plane.z;
+        frustum.d[i] = plane.w;
+    }
+
+    return frustum;
+}
+
+cull_result_t test_aabb(const frustum_t& frustum, const aabb_t& aabb)
+{
+    glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+    glm::vec3 extent = (aabb.max - aabb.min) * 0.5f;
+#if defined(__SSE2__)
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+    __m128 outside = _mm_setzero_ps();
+    __m128 intersects = _mm_setzero_ps();
+    for (std::uint32_t i = 0; i < 8; i += 4)
+    {
+        __m128 nx = _mm_load_ps(frustum.nx + i), ny = _mm_load_ps(frustum.ny + i), nz = _mm_load_ps(frustum.nz + i);
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(frustum.d + i)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, nx), ex), _mm_mul_ps(_mm_andnot_ps(sign_mask, ny), ey)),
+                _mm_mul_ps(_mm_andnot_ps(sign_mask, nz), ez));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_sub_ps(_mm_setzero_ps(), radius)));
+        intersects = _mm_or_ps(intersects, _mm_cmplt_ps(dist, radius));
+    }
+    if (_mm_movemask_ps(outside) != 0) return CULL_OUTSIDE;
+    return (_mm_movemask_ps(intersects) != 0) ? CULL_INTERSECTS : CULL_INSIDE;
+#else
+    cull_result_t result = CULL_INSIDE;
+    for (std::uint32_t i = 0; i < 6; ++i)
+    {
+        float dist = frustum.nx[i] * center.x + frustum.ny[i] * center.y + frustum.nz[i] * center.z + frustum.d[i];
+        float radius = std::abs(frustum.nx[i]) * extent.x + std::abs(frustum.ny[i]) * extent.y + std::abs(frustum.nz[i]) * extent.z;
+        if (dist < -radius) return CULL_OUTSIDE;
+        if (dist < radius) result = CULL_INTERSECTS;
+    }
+    return result;
+#endif
+}
+
+std::vector<mesh_cluster_t> build_clusters(const std::vector<vertex_t>& vertices, const std::vector<std::uint32_t>& indices,
+        std::uint32_t first_index, std::uint32_t index_count, std::uint32_t submesh)
+{
+    std::vector<mesh_cluster_t> clusters;
+    std::uint32_t cluster_indices = CLUSTER_TRIANGLES * 3;
+    for (std::uint32_t begin = first_index; begin < first_index + index_count; begin += cluster_indices)
+    {
+        mesh_cluster_t cluster;
+        cluster.first_index = begin;
+        cluster.index_count = std::min(cluster_indices, first_index + index_count - begin);
+        cluster.submesh = submesh;
+        for (std::uint32_t i = begin; i < begin + cluster.index_count; ++i)
+        {
+            cluster.bounds.grow(vertices[indices[i]].pos);
+        }
+        clusters.push_back(cluster);
+    }
+
+    return clusters;
+}
+
+std::uint32_t bvh_t::build_node(std::uint32_t begin, std::uint32_t end, const std::vector<glm::vec3>& centers)
+{
+    std::uint32_t node_index = static_cast<std::uint32_t>(this->nodes.size());
+    this->nodes.push_back(bvh_node_t());
+    aabb_t bounds, center_bounds;
+    for (std::uint32_t i = begin; i < end; ++i)
+    {
+        bounds.grow(this->clusters[this->cluster_order[i]].bounds);
+        center_bounds.grow(centers[this->cluster_order[i]]);
+    }
+    this->nodes[node_index].bounds = bounds;
+
+    if (end - begin <= BVH_LEAF_CLUSTERS)
+    {
+        this->nodes[node_index].first = begin;
+        this->nodes[node_index].count = end - begin;
+        return node_index;
+    }
+
+    // median split along the widest axis of the cluster centers
+    glm::vec3 size = center_bounds.max - center_bounds.min;
+    std::uint32_t axis = (size.x > size.y && size.x > size.z) ? 0 : ((size.y > size.z) ? 1 : 2);
+    std::uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(this->cluster_order.begin() + begin, this->cluster_order.begin() + mid, this->cluster_order.begin() + end,
+            [&](std::uint32_t a, std::uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+
+    build_node(begin, mid, centers);
+    std::uint32_t right = build_node(mid, end, centers);
+    this->nodes[node_index].first = right;
+    this->nodes[node_index].count = 0;
+    return node_index;
+}
+
+void bvh_t::build(const std::vector<mesh_cluster_t>& clusters)
+{
+    this->clusters = clusters;
+    this->nodes.clear();
+    this->cluster_order.resize(clusters.size());
+    if (clusters.empty()) return;
+
+    std::vector<glm::vec3> centers(clusters.size());
+    for (std::uint32_t i = 0; i < clusters.size(); ++i)
+    {
+        this->cluster_order[i] = i;
+        centers[i] = (clusters[i].bounds.min + clusters[i].bounds.max) * 0.5f;
+    }
+    this->nodes.reserve(2 * clusters.size() / BVH_LEAF_CLUSTERS + 1);
+    build_node(0, static_cast<std::uint32_t>(clusters.size()), centers);
+}
+
+std::vector<draw_range_t> bvh_t::cull(const frustum_t& frustum) const
+{
+    std::vector<draw_range_t> ranges;
+    if (this->nodes.empty()) return ranges;
+
+    std::vector<std::uint8_t> visible(this->clusters.size(), 0);
+    // the left child directly follows its parent, nodes fully inside the frustum skip the tests of their subtree
+    std::vector<std::pair<std::uint32_t, bool>> stack = { { 0, false } };
+    while (!stack.empty())
+    {
+        std::pair<std::uint32_t, bool> entry = stack.back();
+        stack.pop_back();
+        const bvh_node_t& node = this->nodes[entry.first];
+        bool inside = entry.second;
+        if (!inside)
+        {
+            cull_result_t result = test_aabb(frustum, node.bounds);
+            if (result == CULL_OUTSIDE) continue;
+            inside = result == CULL_INSIDE;
+        }
+
+        if (node.count == 0)
+        {
+            stack.push_back({ node.first, inside });
+            stack.push_back({ entry.first + 1, inside });
+            continue;
+        }
+        for (std::uint32_t i = node.first; i < node.first + node.count; ++i)
+        {
+            std::uint32_t cluster = this->cluster_order[i];
+            if (inside || test_aabb(frustum, this->clusters[cluster].bounds) != CULL_OUTSIDE) visible[cluster] = 1;
+        }
+    }
+
+    // clusters are walked in index order so neighbouring visible clusters of the same submesh merge into one draw
+    for (std::uint32_t i = 0; i < this->clusters.size(); ++i)
+    {
+        if (visible[i] == 0) continue;
+        const mesh_cluster_t& cluster = this->clusters[i];
+        if (!ranges.empty() && ranges.back().submesh == cluster.submesh && ranges.back().first_index + ranges.back().index_count == cluster.first_index)
+        {
+            ranges.back().index_count += cluster.index_count;
+        }
+        else
+        {
+            ranges.push_back({ cluster.first_index, cluster.index_count, cluster.submesh });
+        }
+    }
+
+    return ranges;
+}
+
+std::uint32_t bvh_t::get_cluster_count() const
+{
+    return static_cast<std::uint32_t>(this->clusters.size());
+}
+
+const std::vector<mesh_cluster_t>& bvh_t::get_clusters() const
+{
+    return this->clusters;
+}
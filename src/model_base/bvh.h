@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../vulkan_base/vulkan_vertex.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#define CLUSTER_TRIANGLES 256
+#define BVH_LEAF_CLUSTERS 4
+
+struct aabb_t
+{
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    void grow(const glm::vec3& point);
+    void grow(const aabb_t& other);
+};
+
+struct mesh_cluster_t
+{
+    std::uint32_t first_index = 0;
+    std::uint32_t index_count = 0;
+    std::uint32_t submesh = 0;
+    aabb_t bounds;
+};
+
+struct draw_range_t
+{
+    std::uint32_t first_index = 0;
+    std::uint32_t index_count = 0;
+    std::uint32_t submesh = 0;
+};
+
+/// Planes are stored as structure of arrays and padded to eight, so four of them can be tested at once.
+struct frustum_t
+{
+    alignas(16) float nx[8];
+    alignas(16) float ny[8];
+    alignas(16) float nz[8];
+    alignas(16) float d[8];
+};
+
+enum cull_result_t
+{
+    CULL_OUTSIDE,
+    CULL_INTERSECTS,
+    CULL_INSIDE
+};
+
+struct bvh_node_t
+{
+    aabb_t bounds;
+    /// Leaves reference count clusters starting at first in the cluster order, inner nodes have count 0 and their right child at first.
+    std::uint32_t first = 0;
+    std::uint32_t count = 0;
+};
+
+class bvh_t
+{
+    private:
+        std::vector<bvh_node_t> nodes;
+        std::vector<std::uint32_t> cluster_order;
+        std::vector<mesh_cluster_t> clusters;
+
+        std::uint32_t build_node(std::uint32_t begin, std::uint32_t end, const std::vector<glm::vec3>& centers);
+
+    public:
+        void build(const std::vector<mesh_cluster_t>& clusters);
+        std::vector<draw_range_t> cull(const frustum_t& frustum) const;
+        std::uint32_t get_cluster_count() const;
+        const std::vector<mesh_cluster_t>& get_clusters() const;
+};
+
+/// The planes are in the space the matrix transforms from, pass projection * view * model to cull in object space.
+frustum_t extract_frustum(const glm::mat4& matrix);
+cull_result_t test_aabb(const frustum_t& frustum, const aabb_t& aabb);
+std::vector<mesh_cluster_t> build_clusters(const std::vector<vertex_t>& vertices, const std::vector<std::uint32_t>& indices,
+        std::uint32_t first_index, std::uint32_t index_count, std::uint32_t submesh = 0);
@@ -0,0 +1,189 @@
+#include "indirect_draws.h"
+#include "simplify.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+std::int32_t indirect_draws_t::init(const model_t& model, vulkan_context_t* context, std::uint32_t shadow_regions)
+{
+    this->shadow_regions = std::max(1u, shadow_regions);
+    // the bvh only holds the base level, the simplified levels are split into clusters of their own
+    std::vector<mesh_cluster_t> clusters = model.bvh.get_clusters();
+    std::vector<std::uint32_t> cluster_lods(clusters.size(), 0);
+    std::vector<std::vector<std::uint32_t>> level_sizes(model.submeshes.size(), std::vector<std::uint32_t>(MAX_LODS, 0));
+    for (const mesh_cluster_t& cluster : clusters)
+    {
+        if (cluster.submesh < model.submeshes.size()) ++level_sizes[cluster.submesh][0];
+    }
+    for (std::uint32_t s = 0; s < model.submeshes.size(); ++s)
+    {
+        for (std::uint32_t level = 1; level < model.submeshes[s].lod_count; ++level)
+        {
+            const mesh_lod_t& lod = model.submeshes[s].lods[level];
+            std::vector<mesh_cluster_t> lod_clusters = build_clusters(model.vertices, model.indices, lod.first_index, lod.index_count, s);
+            clusters.insert(clusters.end(), lod_clusters.begin(), lod_clusters.end());
+            cluster_lods.insert(cluster_lods.end(), lod_clusters.size(), level);
+            level_sizes[s][level] = static_cast<std::uint32_t>(lod_clusters.size());
+        }
+    }
+    this->cluster_count = static_cast<std::uint32_t>(clusters.size());
+    this->material_count = std::max<std::uint32_t>(1, static_cast<std::uint32_t>(model.materials.size()));
+    this->instance_count = model.get_instance_count();
+    this->instance_buffers = model.instance_buffers;
+    if (this->cluster_count == 0)
+    {
+        std::cerr << "Failed to set up indirect draws, the model has no clusters!" << std::endl;
+        return -1;
+    }
+    if (this->instance_buffers.size() != MAX_FRAMES_IN_FLIGHT)
+    {
+        std::cerr << "Failed to set up indirect draws, the model has no instance buffers!" << std::endl;
+        return -1;
+    }
+
+    // a submesh emits a single level per instance, so every material gets a command region large enough for the largest level of each
+    // of its submeshes for every instance
+    auto material_of = [&](std::uint32_t submesh)
+    {
+        std::uint32_t material = (submesh < model.submeshes.size()) ? model.submeshes[submesh].material : 0;
+        return (material < this->material_count) ? material : 0;
+    };
+    this->material_sizes.assign(this->material_count, 0);
+    for (std::uint32_t s = 0; s < model.submeshes.size(); ++s)
+    {
+        this->material_sizes[material_of(s)] += *std::max_element(level_sizes[s].begin(), level_sizes[s].end()) * this->instance_count;
+    }
+    this->material_offsets.assign(this->material_count, 0);
+    for (std::uint32_t i = 1; i < this->material_count; ++i)
+    {
+        this->material_offsets[i] = this->material_offsets[i - 1] + this->material_sizes[i - 1];
+    }
+    this->shadow_offset = this->material_offsets.back() + this->material_sizes.back();
+
+    std::vector<gpu_cluster_t> gpu_clusters;
+    gpu_clusters.reserve(clusters.size());
+    for (std::uint32_t i = 0; i < clusters.size(); ++i)
+    {
+        const mesh_cluster_t& cluster = clusters[i];
+        std::uint32_t material = material_of(cluster.submesh);
+        glm::vec4 sphere(0.0f);
+        float error = 0.0f;
+        float coarser_error = -1.0f;
+        if (cluster.submesh < model.submeshes.size())
+        {
+            const submesh_t& submesh = model.submeshes[cluster.submesh];
+            glm::vec3 center = (submesh.bounds.min + submesh.bounds.max) * 0.5f;
+            sphere = glm::vec4(center, glm::length(submesh.bounds.max - center));
+            error = submesh.lods[cluster_lods[i]].error;
+            if (cluster_lods[i] + 1 < submesh.lod_count) coarser_error = submesh.lods[cluster_lods[i] + 1].error;
+        }
+        gpu_clusters.push_back({ cluster.bounds.min, cluster.first_index, cluster.bounds.max, cluster.index_count, sphere,
+                material, this->material_offsets[material], error, coarser_error, cluster_lods[i], { 0, 0, 0 } });
+    }
+
+    buffer_settings_t cluster_settings;
+    cluster_settings.populate_defaults(0, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    cluster_settings.size = gpu_clusters.size() * sizeof(gpu_cluster_t);
+    if (context->add_buffer(cluster_settings) != 0) return -1;
+    this->cluster_buffer = context->get_last_buffer();
+    this->cluster_buffer->set_staged_data(gpu_clusters.data());
+
+    for (std::uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        buffer_settings_t command_settings;
+        command_settings.size = (1 + this->shadow_regions) * static_cast<VkDeviceSize>(this->shadow_offset) * sizeof(VkDrawIndexedIndirectCommand);
+        command_settings.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+        if (context->add_buffer(command_settings) != 0) return -1;
+        this->command_buffers.push_back(context->get_last_buffer());
+
+        buffer_settings_t count_settings;
+        count_settings.size = (this->material_count + this->shadow_regions) * sizeof(std::uint32_t);
+        count_settings.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if (context->add_buffer(count_settings) != 0) return -1;
+        this->count_buffers.push_back(context->get_last_buffer());
+
+        buffer_settings_t param_settings;
+        param_settings.size = sizeof(cull_params_t);
+        param_settings.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        param_settings.memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (context->add_buffer(param_settings) != 0) return -1;
+        buffer_t* param_buffer = context->get_last_buffer();
+        param_buffer->map_memory();
+        this->param_buffers.push_back(param_buffer);
+    }
+
+    return 0;
+}
+
+std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>> indirect_draws_t::get_descriptor_config()
+{
+    return {
+        std::make_tuple(0, sizeof(cull_params_t), &this->param_buffers[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, true),
+        std::make_tuple(1, this->cluster_count * sizeof(gpu_cluster_t), &this->cluster_buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, false),
+        std::make_tuple(2, (1 + this->shadow_regions) * this->shadow_offset * sizeof(VkDrawIndexedIndirectCommand), &this->command_buffers[0],
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, true),
+        std::make_tuple(3, (this->material_count + this->shadow_regions) * sizeof(std::uint32_t), &this->count_buffers[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, true),
+        std::make_tuple(4, this->instance_count * sizeof(glm::mat4), &this->instance_buffers[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, true)
+    };
+}
+
+void indirect_draws_t::update(std::uint32_t frame, const glm::mat4& model_view_projection, const glm::mat4& model, const glm::vec3& light_pos, float far_plane,
+        const glm::vec3& camera_pos, float lod_scale, float shadow_lod_scale)
+{
+    // the clusters are in object space, so the frustum and the light are moved there instead of transforming every bound
+    frustum_t frustum = extract_frustum(model_view_projection);
+    cull_params_t params;
+    for (std::uint32_t i = 0; i < 6; ++i)
+    {
+        params.planes[i] = glm::vec4(frustum.nx[i], frustum.ny[i], frustum.nz[i], frustum.d[i]);
+    }
+    params.light = glm::vec4(glm::vec3(glm::inverse(model) * glm::vec4(light_pos, 1.0f)), far_plane);
+    params.camera = glm::vec4(glm::vec3(glm::inverse(model) * glm::vec4(camera_pos, 1.0f)), lod_scale / LOD_PIXEL_ERROR);
+    params.model = model;
+    params.cluster_count = this->cluster_count;
+    params.material_count = this->material_count;
+    params.instance_count = this->instance_count;
+    params.shadow_offset = this->shadow_offset;
+    params.shadow_lod_scale = shadow_lod_scale / LOD_PIXEL_ERROR;
+    params.shadow_regions = this->shadow_regions;
+    std::memcpy(this->param_buffers[frame]->mapped_memory, &params, sizeof(cull_params_t));
+}
+
+void indirect_draws_t::record_cull(VkCommandBuffer command_buffer, std::uint32_t frame, vulkan_context_t* context, std::uint32_t pipeline_index, std::uint32_t pool_index)
+{
+    vkCmdFillBuffer(command_buffer, this->count_buffers[frame]->buffer, 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier clear_barrier{};
+    clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clear_barrier, 0, nullptr, 0, nullptr);
+
+    context->bind_compute_pipeline(command_buffer, pipeline_index, pool_index);
+    vkCmdDispatch(command_buffer, (this->cluster_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, this->instance_count, 1);
+
+    VkMemoryBarrier cull_barrier{};
+    cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &cull_barrier, 0, nullptr, 0, nullptr);
+}
+
+void indirect_draws_t::draw_material(VkCommandBuffer command_buffer, std::uint32_t frame, std::uint32_t material) const
+{
+    if (material >= this->material_count || this->material_sizes[material] == 0) return;
+    vkCmdDrawIndexedIndirectCount(command_buffer, this->command_buffers[frame]->buffer, this->material_offsets[material] * sizeof(VkDrawIndexedIndirectCommand),
+            this->count_buffers[frame]->buffer, material * sizeof(std::uint32_t), this->material_sizes[material], sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void indirect_draws_t::draw_shadow(VkCommandBuffer command_buffer, std::uint32_t frame, std::uint32_t region) const
+{
+    if (region >= this->shadow_regions) return;
+    vkCmdDrawIndexedIndirectCount(command_buffer, this->command_buffers[frame]->buffer, (1 + region) * this->shadow_offset * sizeof(VkDrawIndexedIndirectCommand),
+            this->count_buffers[frame]->buffer, (this->material_count + region) * sizeof(std::uint32_t), this->shadow_offset, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+std::uint32_t indirect_draws_t::get_material_count() const
+{
+    return this->material_count;
+}
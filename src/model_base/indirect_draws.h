@@ -0,0 +1,83 @@
+#pragma once
+
+#include "model_base.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#define CULL_WORKGROUP_SIZE 64
+
+/// Matches the std430 cluster layout in cull.comp, command_offset is the first command of the cluster's material region.
+/// Sphere bounds the whole submesh so all levels of a submesh agree on the selected level, coarser_error is negative on the last level.
+struct gpu_cluster_t
+{
+    glm::vec3 min;
+    std::uint32_t first_index;
+    glm::vec3 max;
+    std::uint32_t index_count;
+    glm::vec4 sphere;
+    std::uint32_t material;
+    std::uint32_t command_offset;
+    float error;
+    float coarser_error;
+    std::uint32_t lod;
+    std::uint32_t padding[3];
+};
+
+struct cull_params_t
+{
+    alignas(16) glm::vec4 planes[6];
+    /// Light position in object space and the shadow far plane in w.
+    alignas(16) glm::vec4 light;
+    /// Camera position in object space and the pixels per unit of error at distance one in w, zero disables the level selection.
+    alignas(16) glm::vec4 camera;
+    /// Takes the object space bounds to world space, the shadow cube faces are aligned to the world axes.
+    alignas(16) glm::mat4 model;
+    alignas(4) std::uint32_t cluster_count;
+    alignas(4) std::uint32_t material_count;
+    alignas(4) std::uint32_t instance_count;
+    alignas(4) std::uint32_t shadow_offset;
+    alignas(4) float shadow_lod_scale;
+    alignas(4) std::uint32_t shadow_regions;
+};
+
+inline const std::vector<VkDescriptorSetLayoutBinding> CULL_LAYOUT_BINDINGS = {
+    { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }
+};
+
+/// GPU culled clusters of one model and all of its instances, every level of detail has its own clusters and only the selected level is emitted.
+/// Each cluster and instance pair is culled on its own and emits a single instance command, firstInstance selects the instance transform.
+/// The first shadow_offset commands are split into one region per material for the camera, after them follow shadow_regions regions of
+/// shadow_offset commands for the light. With one region per cube face a cluster only lands in the faces it reaches into, a single region
+/// holds every cluster that reaches any face. The counts hold one entry per material followed by one per shadow region.
+class indirect_draws_t
+{
+    private:
+        std::uint32_t cluster_count = 0;
+        std::uint32_t shadow_offset = 0;
+        std::uint32_t material_count = 0;
+        std::uint32_t instance_count = 0;
+        std::uint32_t shadow_regions = 1;
+        std::vector<std::uint32_t> material_offsets;
+        std::vector<std::uint32_t> material_sizes;
+        buffer_t* cluster_buffer = nullptr;
+        std::vector<buffer_t*> command_buffers;
+        std::vector<buffer_t*> count_buffers;
+        std::vector<buffer_t*> param_buffers;
+        std::vector<buffer_t*> instance_buffers;
+
+    public:
+        std::int32_t init(const model_t& model, vulkan_context_t* context, std::uint32_t shadow_regions = 1);
+        std::vector<std::tuple<std::uint32_t, VkDeviceSize, void*, VkDescriptorType, bool>> get_descriptor_config();
+        void update(std::uint32_t frame, const glm::mat4& model_view_projection, const glm::mat4& model, const glm::vec3& light_pos, float far_plane,
+                const glm::vec3& camera_pos, float lod_scale, float shadow_lod_scale);
+        void record_cull(VkCommandBuffer command_buffer, std::uint32_t frame, vulkan_context_t* context, std::uint32_t pipeline_index, std::uint32_t pool_index);
+        void draw_material(VkCommandBuffer command_buffer, std::uint32_t frame, std::uint32_t material) const;
+        void draw_shadow(VkCommandBuffer command_buffer, std::uint32_t frame, std::uint32_t region = 0) const;
+        std::uint32_t get_material_count() const;
+};
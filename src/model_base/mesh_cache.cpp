@@ -0,0 +1,195 @@
+#include "mesh_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vulkan_base/debug_print.h"
+
+static bool get_source_stat(const std::string& source_path, std::int64_t& mtime, std::uint64_t& size)
+{
+    struct stat st;
+    if (stat(source_path.c_str(), &st) != 0)
+    {
+        return false;
+    }
+    mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    size = static_cast<std::uint64_t>(st.st_size);
+    return true;
+}
+
+static void write_string(std::ofstream& file, const std::string& str)
+{
+    std::uint32_t length = static_cast<std::uint32_t>(str.size());
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file.write(str.data(), length);
+}
+
+static bool read_string(const std::uint8_t* bytes, std::size_t size, std::size_t& offset, std::string& str)
+{
+    std::uint32_t length;
+    if (offset + sizeof(length) > size) return false;
+    std::memcpy(&length, bytes + offset, sizeof(length));
+    offset += sizeof(length);
+    if (offset + length > size) return false;
+    str.assign(reinterpret_cast<const char*>(bytes + offset), length);
+    offset += length;
+    return true;
+}
+
+static bool read_material(const std::uint8_t* bytes, std::size_t size, std::size_t& offset, material_t& material)
+{
+    return read_string(bytes, size, offset, material.name) && read_string(bytes, size, offset, material.albedo)
+        && read_string(bytes, size, offset, material.specular) && read_string(bytes, size, offset, material.normal)
+        && read_string(bytes, size, offset, material.metallic) && read_string(bytes, size, offset, material.roughness)
+        && read_string(bytes, size, offset, material.ao);
+}
+
+std::string get_mesh_cache_path(const std::string& source_path)
+{
+    return source_path + ".meshcache";
+}
+
+std::int32_t read_mesh_cache(const std::string& source_path, std::uint32_t loader, std::vector<vertex_t>& vertices, std::vector<std::uint32_t>& indices,
+        std::vector<submesh_t>& submeshes, std::vector<material_t>& materials)
+{
+    std::int64_t mtime;
+    std::uint64_t source_size;
+    if (!get_source_stat(source_path, mtime, source_size))
+    {
+        return -1;
+    }
+
+    std::string cache_path = get_mesh_cache_path(source_path);
+    std::int32_t fd = open(cache_path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(mesh_cache_header_t))
+    {
+        close(fd);
+        return -1;
+    }
+    std::size_t file_size = static_cast<std::size_t>(st.st_size);
+    void* data = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    std::int32_t res = -1;
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    mesh_cache_header_t header;
+    std::memcpy(&header, bytes, sizeof(header));
+    // counts of a corrupt file could wrap the sizes below, none of them can be larger than the file itself
+    if (header.vertex_count > file_size / sizeof(vertex_t) || header.index_count > file_size / sizeof(std::uint32_t)
+            || header.submesh_count > file_size / sizeof(submesh_t) || header.material_count > file_size
+            || header.path_length > file_size)
+    {
+        munmap(data, file_size);
+        return -1;
+    }
+    std::size_t vertex_bytes = header.vertex_count * sizeof(vertex_t);
+    std::size_t index_bytes = header.index_count * sizeof(std::uint32_t);
+    std::size_t path_offset = sizeof(header);
+    std::size_t vertex_offset = (path_offset + header.path_length + 15) / 16 * 16;
+    std::size_t index_offset = vertex_offset + vertex_bytes;
+    std::size_t submesh_offset = index_offset + index_bytes;
+    std::size_t material_offset = submesh_offset + header.submesh_count * sizeof(submesh_t);
+
+    if (header.magic == MESH_CACHE_MAGIC && header.version == MESH_CACHE_VERSION && header.vertex_size == sizeof(vertex_t) && header.loader == loader
+            && header.source_mtime == mtime && header.source_size == source_size && header.path_length == source_path.size()
+            && material_offset <= file_size
+            && std::memcmp(bytes + path_offset, source_path.data(), header.path_length) == 0)
+    {
+        madvise(data, file_size, MADV_SEQUENTIAL);
+        std::vector<material_t> cached_materials(header.material_count);
+        bool valid = true;
+        for (material_t& material : cached_materials)
+        {
+            valid = valid && read_material(bytes, file_size, material_offset, material);
+        }
+        if (valid)
+        {
+            const vertex_t* vertex_data = reinterpret_cast<const vertex_t*>(bytes + vertex_offset);
+            const std::uint32_t* index_data = reinterpret_cast<const std::uint32_t*>(bytes + index_offset);
+            vertices.assign(vertex_data, vertex_data + header.vertex_count);
+            indices.assign(index_data, index_data + header.index_count);
+            submeshes.resize(header.submesh_count);
+            std::memcpy(submeshes.data(), bytes + submesh_offset, header.submesh_count * sizeof(submesh_t));
+            materials = std::move(cached_materials);
+            DEBUG_PRINT("Loaded mesh cache: " << cache_path)
+            res = 0;
+        }
+    }
+
+    munmap(data, file_size);
+    return res;
+}
+
+std::int32_t write_mesh_cache(const std::string& source_path, std::uint32_t loader, const std::vector<vertex_t>& vertices, const std::vector<std::uint32_t>& indices,
+        const std::vector<submesh_t>& submeshes, const std::vector<material_t>& materials)
+{
+    mesh_cache_header_t header{};
+    if (!get_source_stat(source_path, header.source_mtime, header.source_size))
+    {
+        return -1;
+    }
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertex_size = sizeof(vertex_t);
+    header.loader = loader;
+    header.vertex_count = vertices.size();
+    header.index_count = indices.size();
+    header.path_length = static_cast<std::uint32_t>(source_path.size());
+    header.submesh_count = static_cast<std::uint32_t>(submeshes.size());
+    header.material_count = static_cast<std::uint32_t>(materials.size());
+
+    std::string cache_path = get_mesh_cache_path(source_path);
+    std::string tmp_path = cache_path + ".tmp";
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open file: " << tmp_path << "!" << std::endl;
+        return -1;
+    }
+
+    std::size_t vertex_offset = (sizeof(header) + header.path_length + 15) / 16 * 16;
+    const char padding[16] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(source_path.data(), header.path_length);
+    file.write(padding, vertex_offset - sizeof(header) - header.path_length);
+    file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(vertex_t));
+    file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(std::uint32_t));
+    file.write(reinterpret_cast<const char*>(submeshes.data()), submeshes.size() * sizeof(submesh_t));
+    for (const material_t& material : materials)
+    {
+        for (const std::string* str : { &material.name, &material.albedo, &material.specular, &material.normal, &material.metallic, &material.roughness, &material.ao })
+        {
+            write_string(file, *str);
+        }
+    }
+    file.close();
+    if (!file)
+    {
+        std::cerr << "Failed to write mesh cache: " << cache_path << "!" << std::endl;
+        std::remove(tmp_path.c_str());
+        return -1;
+    }
+
+    if (std::rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+    {
+        std::remove(tmp_path.c_str());
+        return -1;
+    }
+
+    return 0;
+}
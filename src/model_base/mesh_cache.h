@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../vulkan_base/vulkan_vertex.h"
+#include "submesh.h"
+
+#define MESH_CACHE_MAGIC 0x434d4b56
+#define MESH_CACHE_VERSION 4
+
+struct mesh_cache_header_t
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t vertex_size;
+    std::uint32_t loader;
+    std::int64_t source_mtime;
+    std::uint64_t source_size;
+    std::uint64_t vertex_count;
+    std::uint64_t index_count;
+    std::uint32_t path_length;
+    std::uint32_t submesh_count;
+    std::uint32_t material_count;
+    std::uint32_t padding;
+};
+
+std::string get_mesh_cache_path(const std::string& source_path);
+std::int32_t read_mesh_cache(const std::string& source_path, std::uint32_t loader, std::vector<vertex_t>& vertices, std::vector<std::uint32_t>& indices,
+        std::vector<submesh_t>& submeshes, std::vector<material_t>& materials);
+std::int32_t write_mesh_cache(const std::string& source_path, std::uint32_t loader, const std::vector<vertex_t>& vertices, const std::vector<std::uint32_t>& indices,
+        const std::vector<submesh_t>& submeshes, const std::vector<material_t>& materials);
@@ -0,0 +1,202 @@
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#define NOT_IN_CACHE -1
+
+static float vertex_score(std::int32_t cache_position, std::uint32_t live_triangles)
+{
+    if (live_triangles == 0) return -1.0f;
+
+    // the three vertices of the last triangle get a fixed score so the next triangle does not simply reuse its edge
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        if (cache_position < 3)
+        {
+            score = 0.75f;
+        }
+        else
+        {
+            float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cache_position - 3) * scale, 1.5f);
+        }
+    }
+    // vertices with few remaining triangles are finished first so they leave the cache for good
+    return score + 2.0f / std::sqrt(static_cast<float>(live_triangles));
+}
+
+void optimize_vertex_cache(std::uint32_t* indices, std::uint32_t index_count)
+{
+    std::uint32_t triangle_count = index_count / 3;
+    if (triangle_count < 2) return;
+
+    // the range gets its own compact vertex numbering so the per vertex tables stay small
+    std::vector<std::uint32_t> local(triangle_count * 3);
+    std::unordered_map<std::uint32_t, std::uint32_t> local_ids;
+    for (std::uint32_t i = 0; i < triangle_count * 3; ++i)
+    {
+        local[i] = local_ids.try_emplace(indices[i], static_cast<std::uint32_t>(local_ids.size())).first->second;
+    }
+    std::uint32_t vertex_count = static_cast<std::uint32_t>(local_ids.size());
+
+    std::vector<std::uint32_t> live_triangles(vertex_count, 0);
+    for (std::uint32_t v : local) ++live_triangles[v];
+    std::vector<std::uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for (std::uint32_t v = 0; v < vertex_count; ++v) adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+    std::vector<std::uint32_t> adjacency(triangle_count * 3);
+    std::vector<std::uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (std::uint32_t i = 0; i < triangle_count * 3; ++i) adjacency[fill[local[i]]++] = i / 3;
+
+    std::vector<std::int32_t> cache_positions(vertex_count, NOT_IN_CACHE);
+    std::vector<float> vertex_scores(vertex_count);
+    for (std::uint32_t v = 0; v < vertex_count; ++v) vertex_scores[v] = vertex_score(NOT_IN_CACHE, live_triangles[v]);
+    std::vector<float> triangle_scores(triangle_count);
+    for (std::uint32_t t = 0; t < triangle_count; ++t)
+    {
+        triangle_scores[t] = vertex_scores[local[t * 3]] + vertex_scores[local[t * 3 + 1]] + vertex_scores[local[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<std::uint32_t> cache;
+    std::vector<std::uint32_t> result;
+    result.reserve(triangle_count * 3);
+    std::uint32_t next_unemitted = 0;
+    std::uint32_t best = 0;
+    for (std::uint32_t t = 1; t < triangle_count; ++t)
+    {
+        if (triangle_scores[t] > triangle_scores[best]) best = t;
+    }
+
+    for (std::uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+    {
+        emitted[best] = true;
+        for (std::uint32_t corner = 0; corner < 3; ++corner)
+        {
+            std::uint32_t v = local[best * 3 + corner];
+            result.push_back(indices[best * 3 + corner]);
+
+            // remove the triangle from the vertex's live list, the remaining ones stay in front
+            std::uint32_t* begin = adjacency.data() + adjacency_offsets[v];
+            std::uint32_t* end = begin + live_triangles[v];
+            std::uint32_t* found = std::find(begin, end, best);
+            std::swap(*found, *(end - 1));
+            --live_triangles[v];
+        }
+
+        // the emitted vertices move to the front, everything pushed past the cache size falls out
+        std::vector<std::uint32_t> new_cache = { local[best * 3], local[best * 3 + 1], local[best * 3 + 2] };
+        for (std::uint32_t v : cache)
+        {
+            if (v != new_cache[0] && v != new_cache[1] && v != new_cache[2]) new_cache.push_back(v);
+        }
+        for (std::uint32_t i = 0; i < new_cache.size(); ++i)
+        {
+            cache_positions[new_cache[i]] = (i < VERTEX_CACHE_SIZE) ? static_cast<std::int32_t>(i) : NOT_IN_CACHE;
+        }
+
+        // only triangles touching the old or the new cache change their score, the best of them is the next one
+        float best_score = -1.0f;
+        for (std::uint32_t v : new_cache)
+        {
+            float score = vertex_score(cache_positions[v], live_triangles[v]);
+            float delta = score - vertex_scores[v];
+            vertex_scores[v] = score;
+            for (std::uint32_t j = adjacency_offsets[v]; j < adjacency_offsets[v] + live_triangles[v]; ++j)
+            {
+                std::uint32_t t = adjacency[j];
+                triangle_scores[t] += delta;
+                if (cache_positions[v] != NOT_IN_CACHE && triangle_scores[t] > best_score)
+                {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+        }
+        if (new_cache.size() > VERTEX_CACHE_SIZE) new_cache.resize(VERTEX_CACHE_SIZE);
+        cache.swap(new_cache);
+
+        // nothing in the cache has triangles left, continue with the next triangle in the original order
+        if (best_score < 0.0f)
+        {
+            while (next_unemitted < triangle_count && emitted[next_unemitted]) ++next_unemitted;
+            best = next_unemitted;
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void optimize_overdraw(const std::vector<vertex_t>& vertices, std::uint32_t* indices, std::uint32_t index_count, std::uint32_t cluster_triangles)
+{
+    std::uint32_t cluster_indices = cluster_triangles * 3;
+    std::uint32_t cluster_count = (index_count / 3 + cluster_triangles - 1) / cluster_triangles;
+    if (cluster_count < 2) return;
+
+    glm::vec3 mesh_center(0.0f);
+    float mesh_area = 0.0f;
+    std::vector<glm::vec3> centers(cluster_count, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(cluster_count, glm::vec3(0.0f));
+    std::vector<float> areas(cluster_count, 0.0f);
+    for (std::uint32_t i = 0; i + 2 < index_count; i += 3)
+    {
+        const glm::vec3& p0 = vertices[indices[i]].pos;
+        const glm::vec3& p1 = vertices[indices[i + 1]].pos;
+        const glm::vec3& p2 = vertices[indices[i + 2]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal) * 0.5f;
+        glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+        std::uint32_t cluster = i / cluster_indices;
+        centers[cluster] += center * area;
+        normals[cluster] += normal;
+        areas[cluster] += area;
+        mesh_center += center * area;
+        mesh_area += area;
+    }
+    if (mesh_area <= 0.0f) return;
+    mesh_center /= mesh_area;
+
+    // clusters facing away from the mesh center occlude the inner ones from most directions, so they go first
+    std::vector<float> keys(cluster_count, 0.0f);
+    for (std::uint32_t c = 0; c < cluster_count; ++c)
+    {
+        if (areas[c] <= 0.0f) continue;
+        float length = glm::length(normals[c]);
+        if (length > 0.0f) keys[c] = glm::dot(centers[c] / areas[c] - mesh_center, normals[c] / length);
+    }
+    std::vector<std::uint32_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    // a partial last cluster stays last, so every other cluster keeps a full run and the culling clusters match the runs
+    std::uint32_t sorted_count = (index_count % cluster_indices == 0) ? cluster_count : cluster_count - 1;
+    std::stable_sort(order.begin(), order.begin() + sorted_count, [&](std::uint32_t a, std::uint32_t b) { return keys[a] > keys[b]; });
+
+    std::vector<std::uint32_t> result;
+    result.reserve(index_count);
+    for (std::uint32_t c : order)
+    {
+        std::uint32_t begin = c * cluster_indices;
+        std::uint32_t end = std::min(begin + cluster_indices, index_count);
+        result.insert(result.end(), indices + begin, indices + end);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void optimize_vertex_fetch(std::vector<vertex_t>& vertices, std::vector<std::uint32_t>& indices)
+{
+    std::vector<std::uint32_t> remap(vertices.size(), std::numeric_limits<std::uint32_t>::max());
+    std::vector<vertex_t> fetch_ordered;
+    fetch_ordered.reserve(vertices.size());
+    for (std::uint32_t& index : indices)
+    {
+        if (remap[index] == std::numeric_limits<std::uint32_t>::max())
+        {
+            remap[index] = static_cast<std::uint32_t>(fetch_ordered.size());
+            fetch_ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(fetch_ordered);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../vulkan_base/vulkan_vertex.h"
+#include <cstdint>
+#include <vector>
+
+#define VERTEX_CACHE_SIZE 32
+
+/// Reorders the triangles of an index range for the post transform cache with Forsyth's linear speed algorithm, the vertices stay untouched.
+void optimize_vertex_cache(std::uint32_t* indices, std::uint32_t index_count);
+/// Sorts runs of cluster_triangles triangles so the most outward facing ones are drawn first, run with CLUSTER_TRIANGLES the runs are the culling clusters.
+void optimize_overdraw(const std::vector<vertex_t>& vertices, std::uint32_t* indices, std::uint32_t index_count, std::uint32_t cluster_triangles);
+/// Renumbers the vertices in the order the indices first reference them and drops unreferenced ones.
+void optimize_vertex_fetch(std::vector<vertex_t>& vertices, std::vector<std::uint32_t>& indices);
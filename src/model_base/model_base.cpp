@@ -1,128 +1,369 @@
 #include "model_base.h"
+#include "mesh_cache.h"
+#include "simplify.h"
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <tiny_obj_loader.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-std::optional<std::tuple<buffer_t*, buffer_t*>> model_t::set_up_buffer(vulkan_context_t* context)
+#include "vulkan_base/debug_print.h"
+
+static std::string get_directory(const std::string& path)
+{
+    std::size_t slash = path.find_last_of('/');
+    return (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+}
+
+static std::string resolve_texture(const std::string& directory, const std::string& name)
+{
+    if (name.empty()) return "";
+    std::string path = (name[0] == '/') ? name : directory + name;
+    std::ifstream file(path);
+    if (!file.good())
+    {
+        DEBUG_PRINT("Missing texture: " << path)
+        return "";
+    }
+    return path;
+}
+
+std::optional<std::tuple<buffer_t*, buffer_t*>> model_t::set_up_buffer(vulkan_context_t* context, vertex_format_t format)
 {
+    this->vertex_format = format;
+    std::vector<std::uint8_t> vertex_data = pack_vertices(this->vertices, format, this->dequant);
+
     buffer_settings_t vertex_buffer_settings;
-    vertex_buffer_settings.populate_defaults(static_cast<std::uint32_t>(this->vertices.size()));
+    vertex_buffer_settings.populate_defaults(0);
+    vertex_buffer_settings.size = static_cast<std::uint32_t>(vertex_data.size());
     if (context->add_buffer(vertex_buffer_settings) != 0) return std::nullopt;
     buffer_t* vertex_buffer = context->get_last_buffer();
-    vertex_buffer->set_staged_data(this->vertices.data());
+    vertex_buffer->set_staged_data(vertex_data.data());
     
+    // draws use a vertex offset of zero, so the whole model has to fit 16 bit indices
+    std::vector<std::uint16_t> short_indices;
+    this->index_type = (this->vertices.size() <= 65536) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    if (this->index_type == VK_INDEX_TYPE_UINT16) short_indices.assign(this->indices.begin(), this->indices.end());
+
     buffer_settings_t index_buffer_settings;
     index_buffer_settings.populate_defaults(0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-    index_buffer_settings.size = static_cast<std::uint32_t>(this->indices.size()) * sizeof(std::uint32_t);
+    index_buffer_settings.size = static_cast<std::uint32_t>(this->indices.size()) * ((this->index_type == VK_INDEX_TYPE_UINT16) ? sizeof(std::uint16_t) : sizeof(std::uint32_t));
     if (context->add_buffer(index_buffer_settings) != 0) return std::nullopt;
     buffer_t* index_buffer = context->get_last_buffer();
-    index_buffer->set_staged_data(this->indices.data());
+    if (this->index_type == VK_INDEX_TYPE_UINT16)
+    {
+        index_buffer->set_staged_data(short_indices.data());
+    }
+    else
+    {
+        index_buffer->set_staged_data(this->indices.data());
+    }
     
     return std::make_tuple(vertex_buffer, index_buffer);
 }
 
+// one host visible buffer per frame in flight, so the transforms can change without waiting for the gpu
+std::int32_t model_t::set_up_instance_buffers(vulkan_context_t* context)
+{
+    this->instance_capacity = static_cast<std::uint32_t>(this->instances.size());
+    for (std::uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        buffer_settings_t instance_settings;
+        instance_settings.size = std::max<std::size_t>(1, this->instances.size()) * sizeof(glm::mat4);
+        instance_settings.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        instance_settings.memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (context->add_buffer(instance_settings) != 0) return -1;
+        buffer_t* instance_buffer = context->get_last_buffer();
+        instance_buffer->map_memory();
+        this->instance_buffers.push_back(instance_buffer);
+        update_instances(i);
+    }
+    return 0;
+}
+
+void model_t::update_instances(std::uint32_t frame)
+{
+    if (frame >= this->instance_buffers.size()) return;
+    std::memcpy(this->instance_buffers[frame]->mapped_memory, this->instances.data(), get_instance_count() * sizeof(glm::mat4));
+}
+
+// the count is fixed by set_up_instance_buffers, transforms added later are not drawn
+std::uint32_t model_t::get_instance_count() const
+{
+    return std::min(static_cast<std::uint32_t>(this->instances.size()), this->instance_capacity);
+}
+
 bool model_t::is_initialized()
 {
     return this->initialized;
 }
 
-std::int32_t model_t::tiny_obj_init(const std::string& path)
+std::int32_t model_t::tiny_obj_init(const std::string& path, thread_pool_t* thread_pool)
 {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
+    std::vector<tinyobj::material_t> obj_materials;
     std::string warn, err;
+    std::string directory = get_directory(path);
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+    if (!tinyobj::LoadObj(&attrib, &shapes, &obj_materials, &warn, &err, path.c_str(), directory.c_str()))
     {
         std::cerr << warn + err << std::endl;
         return -1;
     }
 
-    std::unordered_map<vertex_t, std::uint32_t> unique_vertices{};
-    std::unordered_map<vertex_t, glm::vec3> tangents{};
+    for (const tinyobj::material_t& obj_material : obj_materials)
+    {
+        material_t material;
+        material.name = obj_material.name;
+        material.albedo = resolve_texture(directory, obj_material.diffuse_texname);
+        material.specular = resolve_texture(directory, obj_material.specular_texname);
+        material.normal = resolve_texture(directory, obj_material.normal_texname.empty() ? obj_material.bump_texname : obj_material.normal_texname);
+        material.metallic = resolve_texture(directory, obj_material.metallic_texname);
+        material.roughness = resolve_texture(directory, obj_material.roughness_texname);
+        this->materials.push_back(material);
+    }
 
-    for (const tinyobj::shape_t& shape : shapes)
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> shape_ranges;
+    std::uint32_t triangle_count = 0;
+    for (std::uint32_t i = 0; i < shapes.size(); ++i)
     {
-        std::uint32_t count = 0;
-        std::array<vertex_t, 3> tri;
-        for (const tinyobj::index_t& index : shape.mesh.indices)
-        {
-            vertex_t vertex{};
+        std::uint32_t shape_triangles = static_cast<std::uint32_t>(shapes[i].mesh.indices.size() / 3);
+        shape_ranges.emplace_back(triangle_count, shape_triangles);
 
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2],
-            };
+        // a new submesh starts with every shape and whenever the face material changes, triangles keep their order through the dedup below
+        for (std::uint32_t f = 0; f < shape_triangles; ++f)
+        {
+            std::int32_t material_id = (f < shapes[i].mesh.material_ids.size()) ? shapes[i].mesh.material_ids[f] : -1;
+            std::uint32_t material = (material_id < 0) ? NO_MATERIAL : static_cast<std::uint32_t>(material_id);
+            if (f == 0 || this->submeshes.back().material != material)
+            {
+                submesh_t submesh;
+                submesh.first_index = 3 * (triangle_count + f);
+                submesh.material = material;
+                this->submeshes.push_back(submesh);
+            }
+            this->submeshes.back().index_count += 3;
+        }
+        triangle_count += shape_triangles;
+    }
 
-            vertex.tex_coord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-            };
+    auto fetch_vertex = [&](std::uint32_t triangle, std::uint32_t corner)
+    {
+        // the last shape starting at or before the triangle owns it, empty shapes share their start with the next one
+        auto owner = std::upper_bound(shape_ranges.begin(), shape_ranges.end(), triangle,
+                [](std::uint32_t t, const std::pair<std::uint32_t, std::uint32_t>& range) { return t < range.first; });
+        std::size_t shape = static_cast<std::size_t>(owner - shape_ranges.begin()) - 1;
+        const tinyobj::index_t& index = shapes[shape].mesh.indices[3 * (triangle - shape_ranges[shape].first) + corner];
 
-            vertex.normal = {
-                attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2],
-            };
+        vertex_t vertex{};
+        vertex.pos = {
+            attrib.vertices[3 * index.vertex_index + 0],
+            attrib.vertices[3 * index.vertex_index + 1],
+            attrib.vertices[3 * index.vertex_index + 2],
+        };
+        vertex.tex_coord = {
+            attrib.texcoords[2 * index.texcoord_index + 0],
+            1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
+        };
+        vertex.normal = {
+            attrib.normals[3 * index.normal_index + 0],
+            attrib.normals[3 * index.normal_index + 1],
+            attrib.normals[3 * index.normal_index + 2],
+        };
+        return vertex;
+    };
 
-            tri[count] = vertex;
-            count = (count == 2) ? 0 : count + 1;
-            
-            if (count == 0)
+    // each chunk dedups its own triangle range, merging the tables in chunk order through one global table gives every vertex
+    // the id it would get from a single serial pass, so the vertices, the tangents and the mesh cache do not depend on the thread count
+    struct chunk_t
+    {
+        std::vector<vertex_t> vertices;
+        std::vector<std::uint32_t> indices;
+    };
+    std::uint32_t chunk_count = (thread_pool != nullptr) ? std::max(1u, std::min(thread_pool->get_thread_count(), triangle_count / 4096)) : 1;
+    std::vector<chunk_t> chunks(chunk_count);
+    auto process_chunk = [&](std::uint32_t c)
+    {
+        std::uint32_t begin = static_cast<std::uint32_t>(static_cast<std::uint64_t>(triangle_count) * c / chunk_count);
+        std::uint32_t end = static_cast<std::uint32_t>(static_cast<std::uint64_t>(triangle_count) * (c + 1) / chunk_count);
+        chunk_t& chunk = chunks[c];
+        std::unordered_map<vertex_t, std::uint32_t> unique_vertices{};
+        unique_vertices.reserve((end - begin) * 2);
+        chunk.indices.reserve((end - begin) * 3);
+        for (std::uint32_t t = begin; t < end; ++t)
+        {
+            for (std::uint32_t corner = 0; corner < 3; ++corner)
             {
-                vertex_t& a = tri[0];
-                vertex_t& b = tri[1];
-                vertex_t& c = tri[2];
-
-                glm::vec3 ab = b.pos - a.pos;
-                glm::vec3 ac = c.pos - a.pos;
-                glm::vec2 delta_uv_1 = b.tex_coord - a.tex_coord;
-                glm::vec2 delta_uv_2 = c.tex_coord - a.tex_coord;
-
-                float f = 1.0f / (delta_uv_1.x * delta_uv_2.y - delta_uv_2.x * delta_uv_1.y);
-
-                glm::vec3 tangent(
-                        f * (delta_uv_2.y * ab.x - delta_uv_1.y * ac.x),
-                        f * (delta_uv_2.y * ab.y - delta_uv_1.y * ac.y),
-                        f * (delta_uv_2.y * ab.z - delta_uv_1.y * ac.z)
-                        );
-                a.tangent = tangent;
-                b.tangent = tangent;
-                c.tangent = tangent;
-
-                for (vertex_t vert : tri)
-                {
-                    if (unique_vertices.count(vert) == 0)
-                    {
-                        unique_vertices[vert] = static_cast<std::uint32_t>(vertices.size());
-                        this->vertices.push_back(vert);
-                    }
-
-                    tangents[vert] += tangent;
-                    this->indices.push_back(unique_vertices[vert]);
-                }
+                vertex_t vertex = fetch_vertex(t, corner);
+                auto res = unique_vertices.try_emplace(vertex, static_cast<std::uint32_t>(chunk.vertices.size()));
+                if (res.second) chunk.vertices.push_back(vertex);
+                chunk.indices.push_back(res.first->second);
             }
         }
+    };
+    if (chunk_count > 1)
+    {
+        thread_pool->parallel_for(chunk_count, process_chunk);
+    }
+    else
+    {
+        process_chunk(0);
     }
 
-    for (vertex_t& vert : this->vertices)
+    std::unordered_map<vertex_t, std::uint32_t> unique_vertices{};
+    unique_vertices.reserve(chunks[0].vertices.size() * chunk_count);
+    this->indices.reserve(static_cast<std::size_t>(triangle_count) * 3);
+    for (chunk_t& chunk : chunks)
     {
-        vert.tangent = glm::normalize(tangents[vert]);
+        std::vector<std::uint32_t> remap(chunk.vertices.size());
+        for (std::uint32_t i = 0; i < chunk.vertices.size(); ++i)
+        {
+            auto res = unique_vertices.try_emplace(chunk.vertices[i], static_cast<std::uint32_t>(this->vertices.size()));
+            if (res.second) this->vertices.push_back(chunk.vertices[i]);
+            remap[i] = res.first->second;
+        }
+        for (std::uint32_t index : chunk.indices)
+        {
+            this->indices.push_back(remap[index]);
+        }
+        chunk = chunk_t();
     }
 
+    calculate_tangents(thread_pool);
+    finalize_submeshes();
+
     this->initialized = true;
     return 0;
 }
 
+void model_t::finalize_submeshes()
+{
+    // loaders without submesh information get one submesh over everything, submeshes without a material share an empty default one
+    if (this->submeshes.empty())
+    {
+        submesh_t submesh;
+        submesh.index_count = static_cast<std::uint32_t>(this->indices.size());
+        this->submeshes.push_back(submesh);
+    }
+
+    std::uint32_t default_material = NO_MATERIAL;
+    for (submesh_t& submesh : this->submeshes)
+    {
+        if (submesh.material >= this->materials.size())
+        {
+            if (default_material == NO_MATERIAL)
+            {
+                default_material = static_cast<std::uint32_t>(this->materials.size());
+                this->materials.push_back({ "default" });
+            }
+            submesh.material = default_material;
+        }
+
+        std::uint32_t min_vertex = std::numeric_limits<std::uint32_t>::max(), max_vertex = 0;
+        submesh.bounds = aabb_t();
+        for (std::uint32_t i = submesh.first_index; i < submesh.first_index + submesh.index_count; ++i)
+        {
+            min_vertex = std::min(min_vertex, this->indices[i]);
+            max_vertex = std::max(max_vertex, this->indices[i]);
+            submesh.bounds.grow(this->vertices[this->indices[i]].pos);
+        }
+        submesh.first_vertex = (submesh.index_count > 0) ? min_vertex : 0;
+        submesh.vertex_count = (submesh.index_count > 0) ? max_vertex - min_vertex + 1 : 0;
+    }
+}
+
+void model_t::calculate_tangents(thread_pool_t* thread_pool)
+{
+    std::uint32_t triangle_count = static_cast<std::uint32_t>(this->indices.size() / 3);
+
+    // face tangents are computed in a branch free structure of arrays pass so the compiler can vectorise it
+    std::vector<float> tx(triangle_count), ty(triangle_count), tz(triangle_count);
+    auto face_tangents = [&](std::uint32_t begin, std::uint32_t end)
+    {
+        const vertex_t* verts = this->vertices.data();
+        const std::uint32_t* idx = this->indices.data();
+        for (std::uint32_t t = begin; t < end; ++t)
+        {
+            const vertex_t& a = verts[idx[3 * t + 0]];
+            const vertex_t& b = verts[idx[3 * t + 1]];
+            const vertex_t& c = verts[idx[3 * t + 2]];
+            float du1 = b.tex_coord.x - a.tex_coord.x, dv1 = b.tex_coord.y - a.tex_coord.y;
+            float du2 = c.tex_coord.x - a.tex_coord.x, dv2 = c.tex_coord.y - a.tex_coord.y;
+            float det = du1 * dv2 - du2 * dv1;
+            float f = (det != 0.0f) ? 1.0f / det : 0.0f;
+            tx[t] = f * (dv2 * (b.pos.x - a.pos.x) - dv1 * (c.pos.x - a.pos.x));
+            ty[t] = f * (dv2 * (b.pos.y - a.pos.y) - dv1 * (c.pos.y - a.pos.y));
+            tz[t] = f * (dv2 * (b.pos.z - a.pos.z) - dv1 * (c.pos.z - a.pos.z));
+        }
+    };
+
+    std::uint32_t chunk_count = (thread_pool != nullptr) ? std::max(1u, std::min(thread_pool->get_thread_count(), triangle_count / 16384)) : 1;
+    auto chunk_range = [&](std::uint32_t c, std::uint32_t count)
+    {
+        return std::make_pair(static_cast<std::uint32_t>(static_cast<std::uint64_t>(count) * c / chunk_count),
+                static_cast<std::uint32_t>(static_cast<std::uint64_t>(count) * (c + 1) / chunk_count));
+    };
+    if (chunk_count > 1)
+    {
+        thread_pool->parallel_for(chunk_count, [&](std::uint32_t c) { auto r = chunk_range(c, triangle_count); face_tangents(r.first, r.second); });
+    }
+    else
+    {
+        face_tangents(0, triangle_count);
+    }
+
+    for (vertex_t& vert : this->vertices)
+    {
+        vert.tangent = glm::vec3(0.0f);
+    }
+    for (std::uint32_t t = 0; t < triangle_count; ++t)
+    {
+        glm::vec3 tangent(tx[t], ty[t], tz[t]);
+        this->vertices[this->indices[3 * t + 0]].tangent += tangent;
+        this->vertices[this->indices[3 * t + 1]].tangent += tangent;
+        this->vertices[this->indices[3 * t + 2]].tangent += tangent;
+    }
+
+    auto normalize_tangents = [&](std::uint32_t begin, std::uint32_t end)
+    {
+        for (std::uint32_t i = begin; i < end; ++i)
+        {
+            this->vertices[i].tangent = glm::normalize(this->vertices[i].tangent);
+        }
+    };
+    std::uint32_t vertex_count = static_cast<std::uint32_t>(this->vertices.size());
+    if (chunk_count > 1)
+    {
+        thread_pool->parallel_for(chunk_count, [&](std::uint32_t c) { auto r = chunk_range(c, vertex_count); normalize_tangents(r.first, r.second); });
+    }
+    else
+    {
+        normalize_tangents(0, vertex_count);
+    }
+}
+
+static std::string get_assimp_texture(const aiMaterial* material, aiTextureType type, const std::string& directory)
+{
+    if (material->GetTextureCount(type) == 0) return "";
+    aiString name;
+    material->GetTexture(type, 0, &name);
+    return resolve_texture(directory, name.C_Str());
+}
+
 void process_node(model_t* model, aiNode* node, const aiScene* scene)
 {
     for (std::uint32_t i = 0; i < node->mNumMeshes; ++i)
     {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        std::uint32_t offset = model->vertices.size();
+        submesh_t submesh;
+        submesh.first_index = model->indices.size();
+        submesh.material = mesh->mMaterialIndex;
 
         for (std::uint32_t j = 0; j < mesh->mNumVertices; ++j)
         {
@@ -154,7 +395,6 @@ void process_node(model_t* model, aiNode* node, const aiScene* scene)
             model->vertices.push_back(vertex);
         }
 
-        std::uint32_t offset = model->vertices.size();
         for (std::uint32_t j = 0; j < mesh->mNumFaces; ++j)
         {
             aiFace face = mesh->mFaces[j];
@@ -163,6 +403,8 @@ void process_node(model_t* model, aiNode* node, const aiScene* scene)
                 model->indices.push_back(offset + face.mIndices[k]);
             }
         }
+        submesh.index_count = model->indices.size() - submesh.first_index;
+        model->submeshes.push_back(submesh);
     }
 
     for (std::uint32_t i = 0; i < node->mNumChildren; ++i)
@@ -182,18 +424,152 @@ std::int32_t model_t::assimp_init(const std::string& path)
         return -1;
     }
 
+    std::string directory = get_directory(path);
+    for (std::uint32_t i = 0; i < scene->mNumMaterials; ++i)
+    {
+        const aiMaterial* scene_material = scene->mMaterials[i];
+        material_t material;
+        material.name = scene_material->GetName().C_Str();
+        material.albedo = get_assimp_texture(scene_material, aiTextureType_DIFFUSE, directory);
+        material.specular = get_assimp_texture(scene_material, aiTextureType_SPECULAR, directory);
+        material.normal = get_assimp_texture(scene_material, aiTextureType_NORMALS, directory);
+        if (material.normal.empty()) material.normal = get_assimp_texture(scene_material, aiTextureType_HEIGHT, directory);
+        material.metallic = get_assimp_texture(scene_material, aiTextureType_METALNESS, directory);
+        material.roughness = get_assimp_texture(scene_material, aiTextureType_DIFFUSE_ROUGHNESS, directory);
+        material.ao = get_assimp_texture(scene_material, aiTextureType_AMBIENT_OCCLUSION, directory);
+        this->materials.push_back(material);
+    }
+
     process_node(this, scene->mRootNode, scene);
+    finalize_submeshes();
 
     this->initialized = true;
     return 0;
 }
 
-model_t::model_t(const std::string& path, bool assimp)
+void model_t::generate_lods(thread_pool_t* thread_pool)
+{
+    // each level halves the previous one, a submesh stops early once the locked seams keep it above 80 percent of its previous level
+    std::vector<std::vector<std::vector<std::uint32_t>>> levels(this->submeshes.size());
+    auto process_submesh = [&](std::uint32_t s)
+    {
+        submesh_t& submesh = this->submeshes[s];
+        submesh.lod_count = 1;
+        submesh.lods[0] = { submesh.first_index, submesh.index_count, 0.0f };
+        std::vector<std::uint32_t> previous(this->indices.begin() + submesh.first_index, this->indices.begin() + submesh.first_index + submesh.index_count);
+        float error = 0.0f;
+        for (std::uint32_t level = 1; level < MAX_LODS; ++level)
+        {
+            std::uint32_t target = static_cast<std::uint32_t>(previous.size() / 6 * 3);
+            if (target < 3 * LOD_MIN_TRIANGLES) break;
+            float level_error = 0.0f;
+            std::vector<std::uint32_t> simplified = simplify_indices(this->vertices, previous.data(), static_cast<std::uint32_t>(previous.size()), target, level_error);
+            if (simplified.size() * 5 > previous.size() * 4) break;
+
+            // every level is simplified from the one before, so the errors add up
+            error += level_error;
+            submesh.lods[level].error = error;
+            submesh.lod_count = level + 1;
+            levels[s].push_back(simplified);
+            previous = std::move(simplified);
+        }
+    };
+    if (thread_pool != nullptr && this->submeshes.size() > 1)
+    {
+        thread_pool->parallel_for(static_cast<std::uint32_t>(this->submeshes.size()), process_submesh);
+    }
+    else
+    {
+        for (std::uint32_t s = 0; s < this->submeshes.size(); ++s) process_submesh(s);
+    }
+
+    for (std::uint32_t s = 0; s < this->submeshes.size(); ++s)
+    {
+        for (std::uint32_t level = 1; level < this->submeshes[s].lod_count; ++level)
+        {
+            const std::vector<std::uint32_t>& lod_indices = levels[s][level - 1];
+            this->submeshes[s].lods[level].first_index = static_cast<std::uint32_t>(this->indices.size());
+            this->submeshes[s].lods[level].index_count = static_cast<std::uint32_t>(lod_indices.size());
+            this->indices.insert(this->indices.end(), lod_indices.begin(), lod_indices.end());
+        }
+    }
+}
+
+void model_t::optimize_indices(thread_pool_t* thread_pool)
 {
-    if (!assimp)
+    // every level is reordered on its own, the overdraw runs line up with the clusters build_clusters cuts from the same ranges
+    auto process_submesh = [&](std::uint32_t s)
+    {
+        const submesh_t& submesh = this->submeshes[s];
+        for (std::uint32_t level = 0; level < submesh.lod_count; ++level)
+        {
+            std::uint32_t* lod_indices = this->indices.data() + submesh.lods[level].first_index;
+            optimize_vertex_cache(lod_indices, submesh.lods[level].index_count);
+            optimize_overdraw(this->vertices, lod_indices, submesh.lods[level].index_count, CLUSTER_TRIANGLES);
+        }
+    };
+    if (thread_pool != nullptr && this->submeshes.size() > 1)
+    {
+        thread_pool->parallel_for(static_cast<std::uint32_t>(this->submeshes.size()), process_submesh);
+    }
+    else
     {
-        tiny_obj_init(path);
-        return;
+        for (std::uint32_t s = 0; s < this->submeshes.size(); ++s) process_submesh(s);
+    }
+
+    optimize_vertex_fetch(this->vertices, this->indices);
+    for (submesh_t& submesh : this->submeshes)
+    {
+        std::uint32_t min_vertex = std::numeric_limits<std::uint32_t>::max(), max_vertex = 0;
+        for (std::uint32_t i = submesh.first_index; i < submesh.first_index + submesh.index_count; ++i)
+        {
+            min_vertex = std::min(min_vertex, this->indices[i]);
+            max_vertex = std::max(max_vertex, this->indices[i]);
+        }
+        submesh.first_vertex = (submesh.index_count > 0) ? min_vertex : 0;
+        submesh.vertex_count = (submesh.index_count > 0) ? max_vertex - min_vertex + 1 : 0;
+    }
+}
+
+model_t::model_t(const std::string& path, bool assimp, bool use_cache, thread_pool_t* thread_pool)
+{
+    std::uint32_t loader = (assimp) ? 1 : 0;
+    if (use_cache && read_mesh_cache(path, loader, this->vertices, this->indices, this->submeshes, this->materials) == 0)
+    {
+        this->initialized = true;
+    }
+    else
+    {
+        if (!assimp)
+        {
+            tiny_obj_init(path, thread_pool);
+        }
+        else
+        {
+            assimp_init(path);
+        }
+
+        if (this->initialized)
+        {
+            generate_lods(thread_pool);
+            optimize_indices(thread_pool);
+        }
+
+        if (use_cache && this->initialized)
+        {
+            write_mesh_cache(path, loader, this->vertices, this->indices, this->submeshes, this->materials);
+        }
+    }
+
+    if (this->initialized)
+    {
+        // clusters never straddle submeshes, so every visible range has a single material
+        std::vector<mesh_cluster_t> clusters;
+        for (std::uint32_t i = 0; i < this->submeshes.size(); ++i)
+        {
+            std::vector<mesh_cluster_t> submesh_clusters = build_clusters(this->vertices, this->indices, this->submeshes[i].first_index, this->submeshes[i].index_count, i);
+            clusters.insert(clusters.end(), submesh_clusters.begin(), submesh_clusters.end());
+        }
+        this->bvh.build(clusters);
     }
-    assimp_init(path);
 }
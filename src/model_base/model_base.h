@@ -3,17 +3,37 @@
 #include <string>
 #include <vulkan_base/vulkan_base.h>
 #include <vulkan_base/vulkan_vertex.h>
+#include "bvh.h"
+#include "submesh.h"
 
 class model_t
 {
     private:
         bool initialized = false;
+        std::uint32_t instance_capacity = 0;
         std::int32_t assimp_init(const std::string& path);
-        std::int32_t tiny_obj_init(const std::string& path);
+        std::int32_t tiny_obj_init(const std::string& path, thread_pool_t* thread_pool);
+        void calculate_tangents(thread_pool_t* thread_pool);
+        void finalize_submeshes();
+        void generate_lods(thread_pool_t* thread_pool);
+        void optimize_indices(thread_pool_t* thread_pool);
     public:
         std::vector<vertex_t> vertices;
         std::vector<std::uint32_t> indices;
-        std::optional<std::tuple<buffer_t*, buffer_t*>> set_up_buffer(vulkan_context_t* context);
+        std::vector<submesh_t> submeshes;
+        std::vector<material_t> materials;
+        vertex_format_t vertex_format = VERTEX_FORMAT_FULL;
+        vertex_dequant_t dequant;
+        /// Set by set_up_buffer, models with at most 65536 vertices get a 16 bit index buffer.
+        VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+        bvh_t bvh;
+        /// Object transforms of the drawn copies, the shaders apply them through gl_InstanceIndex on top of the ubo model matrix.
+        std::vector<glm::mat4> instances = { glm::mat4(1.0f) };
+        std::vector<buffer_t*> instance_buffers;
+        std::optional<std::tuple<buffer_t*, buffer_t*>> set_up_buffer(vulkan_context_t* context, vertex_format_t format = VERTEX_FORMAT_FULL);
+        std::int32_t set_up_instance_buffers(vulkan_context_t* context);
+        void update_instances(std::uint32_t frame);
+        std::uint32_t get_instance_count() const;
         bool is_initialized();
-        model_t(const std::string& path, bool assimp = true);
+        model_t(const std::string& path, bool assimp = true, bool use_cache = true, thread_pool_t* thread_pool = nullptr);
 };
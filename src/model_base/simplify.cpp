@@ -0,0 +1,233 @@
+#include "simplify.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+struct quadric_t
+{
+    double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0, b2 = 0.0, bc = 0.0, bd = 0.0, c2 = 0.0, cd = 0.0, d2 = 0.0;
+
+    void add_plane(const glm::dvec3& n, double d, double weight)
+    {
+        this->a2 += weight * n.x * n.x; this->ab += weight * n.x * n.y; this->ac += weight * n.x * n.z; this->ad += weight * n.x * d;
+        this->b2 += weight * n.y * n.y; this->bc += weight * n.y * n.z; this->bd += weight * n.y * d;
+        this->c2 += weight * n.z * n.z; this->cd += weight * n.z * d;
+        this->d2 += weight * d * d;
+    }
+
+    void add(const quadric_t& other)
+    {
+        this->a2 += other.a2; this->ab += other.ab; this->ac += other.ac; this->ad += other.ad;
+        this->b2 += other.b2; this->bc += other.bc; this->bd += other.bd;
+        this->c2 += other.c2; this->cd += other.cd;
+        this->d2 += other.d2;
+    }
+
+    double evaluate(const glm::dvec3& p) const
+    {
+        return this->a2 * p.x * p.x + 2.0 * this->ab * p.x * p.y + 2.0 * this->ac * p.x * p.z + 2.0 * this->ad * p.x
+            + this->b2 * p.y * p.y + 2.0 * this->bc * p.y * p.z + 2.0 * this->bd * p.y
+            + this->c2 * p.z * p.z + 2.0 * this->cd * p.z + this->d2;
+    }
+};
+
+struct collapse_t
+{
+    double cost;
+    double distance;
+    std::uint32_t from;
+    std::uint32_t to;
+    std::uint32_t from_version;
+    std::uint32_t to_version;
+
+    bool operator>(const collapse_t& other) const { return this->cost > other.cost; }
+};
+
+struct position_hash_t
+{
+    std::size_t operator()(const glm::vec3& p) const
+    {
+        std::uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+std::vector<std::uint32_t> simplify_indices(const std::vector<vertex_t>& vertices, const std::uint32_t* indices, std::uint32_t index_count,
+        std::uint32_t target_index_count, float& error)
+{
+    error = 0.0f;
+
+    // the submesh gets its own compact vertex numbering so the per vertex tables stay small
+    std::vector<std::uint32_t> global_ids;
+    std::unordered_map<std::uint32_t, std::uint32_t> local_ids;
+    std::vector<std::array<std::uint32_t, 3>> triangles(index_count / 3);
+    for (std::uint32_t i = 0; i < triangles.size() * 3; ++i)
+    {
+        auto res = local_ids.try_emplace(indices[i], static_cast<std::uint32_t>(global_ids.size()));
+        if (res.second) global_ids.push_back(indices[i]);
+        triangles[i / 3][i % 3] = res.first->second;
+    }
+    std::uint32_t vertex_count = static_cast<std::uint32_t>(global_ids.size());
+    auto position = [&](std::uint32_t v) { return glm::dvec3(vertices[global_ids[v]].pos); };
+
+    std::vector<quadric_t> quadrics(vertex_count);
+    std::vector<std::vector<std::uint32_t>> adjacency(vertex_count);
+    std::unordered_map<std::uint64_t, std::uint32_t> edge_counts;
+    aabb_t bounds;
+    for (std::uint32_t t = 0; t < triangles.size(); ++t)
+    {
+        const std::array<std::uint32_t, 3>& tri = triangles[t];
+        glm::dvec3 p0 = position(tri[0]), p1 = position(tri[1]), p2 = position(tri[2]);
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(n);
+        if (length > 0.0)
+        {
+            n /= length;
+            // unweighted planes keep the square root of the quadric an upper bound of the distance to the original surface
+            for (std::uint32_t corner = 0; corner < 3; ++corner) quadrics[tri[corner]].add_plane(n, -glm::dot(n, p0), 1.0);
+        }
+        for (std::uint32_t corner = 0; corner < 3; ++corner)
+        {
+            adjacency[tri[corner]].push_back(t);
+            std::uint32_t a = std::min(tri[corner], tri[(corner + 1) % 3]), b = std::max(tri[corner], tri[(corner + 1) % 3]);
+            ++edge_counts[(static_cast<std::uint64_t>(a) << 32) | b];
+            bounds.grow(vertices[global_ids[tri[corner]]].pos);
+        }
+    }
+
+    // uv seams split vertices at the same position and open borders have edges with one triangle, moving either would tear the mesh
+    std::vector<bool> locked(vertex_count, false);
+    std::unordered_map<glm::vec3, std::uint32_t, position_hash_t> position_counts;
+    for (std::uint32_t v = 0; v < vertex_count; ++v) ++position_counts[vertices[global_ids[v]].pos];
+    for (std::uint32_t v = 0; v < vertex_count; ++v) locked[v] = position_counts[vertices[global_ids[v]].pos] > 1;
+    for (const auto& edge : edge_counts)
+    {
+        if (edge.second != 1) continue;
+        locked[static_cast<std::uint32_t>(edge.first >> 32)] = true;
+        locked[static_cast<std::uint32_t>(edge.first & 0xffffffffu)] = true;
+    }
+
+    // attribute differences are weighted against squared distances relative to the mesh size
+    glm::vec3 diagonal = bounds.max - bounds.min;
+    double attribute_weight = 0.01 * glm::dot(diagonal, diagonal);
+    std::vector<std::uint32_t> versions(vertex_count, 0);
+    std::priority_queue<collapse_t, std::vector<collapse_t>, std::greater<collapse_t>> queue;
+    auto push_collapse = [&](std::uint32_t from, std::uint32_t to)
+    {
+        if (locked[from] || from == to) return;
+        quadric_t quadric = quadrics[from];
+        quadric.add(quadrics[to]);
+        double distance = std::max(0.0, quadric.evaluate(position(to)));
+        const vertex_t& a = vertices[global_ids[from]];
+        const vertex_t& b = vertices[global_ids[to]];
+        glm::vec2 uv_delta = a.tex_coord - b.tex_coord;
+        double attribute = glm::dot(uv_delta, uv_delta) + (1.0 - glm::dot(a.normal, b.normal));
+        queue.push({ distance + attribute_weight * attribute, distance, from, to, versions[from], versions[to] });
+    };
+    for (const std::array<std::uint32_t, 3>& tri : triangles)
+    {
+        for (std::uint32_t corner = 0; corner < 3; ++corner)
+        {
+            push_collapse(tri[corner], tri[(corner + 1) % 3]);
+            push_collapse(tri[(corner + 1) % 3], tri[corner]);
+        }
+    }
+
+    std::vector<bool> removed(triangles.size(), false);
+    std::vector<bool> collapsed(vertex_count, false);
+    std::uint32_t live_triangles = static_cast<std::uint32_t>(triangles.size());
+    double max_distance = 0.0;
+    while (live_triangles * 3 > target_index_count && !queue.empty())
+    {
+        collapse_t collapse = queue.top();
+        queue.pop();
+        if (collapsed[collapse.from] || collapsed[collapse.to]) continue;
+        if (versions[collapse.from] != collapse.from_version || versions[collapse.to] != collapse.to_version) continue;
+
+        // reject collapses that flip or degenerate a remaining triangle
+        bool valid = true;
+        for (std::uint32_t t : adjacency[collapse.from])
+        {
+            if (removed[t]) continue;
+            const std::array<std::uint32_t, 3>& tri = triangles[t];
+            if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) continue;
+            glm::dvec3 before[3], after[3];
+            for (std::uint32_t corner = 0; corner < 3; ++corner)
+            {
+                before[corner] = position(tri[corner]);
+                after[corner] = position(tri[corner] == collapse.from ? collapse.to : tri[corner]);
+            }
+            glm::dvec3 n_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::dvec3 n_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+            double area = glm::length(n_after);
+            if (area <= 1e-12 || glm::dot(n_before, n_after) < 0.2 * glm::length(n_before) * area)
+            {
+                valid = false;
+                break;
+            }
+        }
+        if (!valid) continue;
+
+        for (std::uint32_t t : adjacency[collapse.from])
+        {
+            if (removed[t]) continue;
+            std::array<std::uint32_t, 3>& tri = triangles[t];
+            if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+            {
+                removed[t] = true;
+                --live_triangles;
+                continue;
+            }
+            for (std::uint32_t& v : tri) if (v == collapse.from) v = collapse.to;
+            adjacency[collapse.to].push_back(t);
+        }
+        quadrics[collapse.to].add(quadrics[collapse.from]);
+        collapsed[collapse.from] = true;
+        ++versions[collapse.to];
+        max_distance = std::max(max_distance, collapse.distance);
+
+        for (std::uint32_t t : adjacency[collapse.to])
+        {
+            if (removed[t]) continue;
+            for (std::uint32_t v : triangles[t])
+            {
+                push_collapse(v, collapse.to);
+                push_collapse(collapse.to, v);
+            }
+        }
+    }
+
+    std::vector<std::uint32_t> result;
+    result.reserve(live_triangles * 3);
+    for (std::uint32_t t = 0; t < triangles.size(); ++t)
+    {
+        if (removed[t]) continue;
+        for (std::uint32_t v : triangles[t]) result.push_back(global_ids[v]);
+    }
+    error = static_cast<float>(std::sqrt(max_distance));
+    return result;
+}
+
+float get_lod_scale(float fov_degrees, float viewport_height)
+{
+    return viewport_height / (2.0f * std::tan(glm::radians(fov_degrees) * 0.5f));
+}
+
+std::uint32_t select_lod(const submesh_t& submesh, const glm::vec3& eye, float lod_scale)
+{
+    glm::vec3 center = (submesh.bounds.min + submesh.bounds.max) * 0.5f;
+    float radius = glm::length(submesh.bounds.max - center);
+    float distance = std::max(glm::length(eye - center) - radius, 1e-3f);
+
+    std::uint32_t lod = 0;
+    for (std::uint32_t i = 1; i < submesh.lod_count; ++i)
+    {
+        if (submesh.lods[i].error * lod_scale > LOD_PIXEL_ERROR * distance) break;
+        lod = i;
+    }
+    return lod;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "submesh.h"
+#include "../vulkan_base/vulkan_vertex.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#define LOD_PIXEL_ERROR 1.0f
+#define LOD_MIN_TRIANGLES 64
+
+/// Quadric edge collapse onto existing vertices, so the result indexes the same vertex buffer. Seam and border vertices never move,
+/// the cost of a collapse also grows with the uv and normal difference of its two vertices. Error receives the largest collapse distance.
+std::vector<std::uint32_t> simplify_indices(const std::vector<vertex_t>& vertices, const std::uint32_t* indices, std::uint32_t index_count,
+        std::uint32_t target_index_count, float& error);
+
+/// Pixels covered by one object space unit at distance one, for a perspective projection over the given viewport height.
+float get_lod_scale(float fov_degrees, float viewport_height);
+/// Picks the coarsest level whose error covers at most LOD_PIXEL_ERROR pixels, the eye has to be in the submesh's object space.
+std::uint32_t select_lod(const submesh_t& submesh, const glm::vec3& eye, float lod_scale);
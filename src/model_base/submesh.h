@@ -0,0 +1,42 @@
+#pragma once
+
+#include "bvh.h"
+#include <cstdint>
+#include <string>
+
+#define NO_MATERIAL 0xffffffffu
+#define MAX_LODS 4
+
+/// Error is the largest object space distance the level deviates from the base mesh, level 0 is the base mesh with an error of 0.
+struct mesh_lod_t
+{
+    std::uint32_t first_index = 0;
+    std::uint32_t index_count = 0;
+    float error = 0.0f;
+};
+
+/// Indices stay absolute into the model's vertex buffer, the vertex range only records which vertices the submesh references.
+/// The simplified levels share the vertices of the base mesh, their indices are appended after all base ranges.
+struct submesh_t
+{
+    std::uint32_t first_index = 0;
+    std::uint32_t index_count = 0;
+    std::uint32_t first_vertex = 0;
+    std::uint32_t vertex_count = 0;
+    std::uint32_t material = NO_MATERIAL;
+    aabb_t bounds;
+    std::uint32_t lod_count = 1;
+    mesh_lod_t lods[MAX_LODS];
+};
+
+/// Texture paths are resolved against the model's directory, textures that are missing on disk are left empty.
+struct material_t
+{
+    std::string name;
+    std::string albedo;
+    std::string specular;
+    std::string normal;
+    std::string metallic;
+    std::string roughness;
+    std::string ao;
+};
@@ -1,9 +1,8 @@
 #version 450
 
-layout (location = 0) out vec3 g_position;
-layout (location = 1) out vec3 g_normal;
-layout (location = 2) out vec4 g_albedo;
-layout (location = 3) out vec3 g_pbr;
+layout (location = 0) out vec2 g_normal;
+layout (location = 1) out vec4 g_albedo;
+layout (location = 2) out vec4 g_pbr;
 
 layout (location = 0) in vec3 frag_pos;
 layout (location = 1) in vec3 frag_normal;
@@ -22,18 +21,30 @@ layout (binding = 7) uniform flags_t
     bool normal_map;
 } flags;
 
+vec2 octahedral_encode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return n.xy;
+}
+
+// the position is not stored, the lighting pass reconstructs it from the depth buffer
 void main()
 {
-    g_position = frag_pos;
     g_albedo.rgb = texture(texture_albedo, frag_tex_coord).rgb;
     g_albedo.a = texture(texture_specular, frag_tex_coord).r;
+    vec3 normal;
     if (flags.normal_map)
     {
-        g_normal = normalize(frag_TBN * (texture(texture_normal, frag_tex_coord).rgb * 2.0 - 1.0));
+        normal = normalize(frag_TBN * (texture(texture_normal, frag_tex_coord).rgb * 2.0 - 1.0));
     }
     else
     {
-        g_normal = normalize(frag_normal);
+        normal = normalize(frag_normal);
     }
-    g_pbr = vec3(texture(texture_metallic, frag_tex_coord).r, texture(texture_roughness, frag_tex_coord).r, texture(texture_ao, frag_tex_coord).r);
+    g_normal = octahedral_encode(normal);
+    g_pbr = vec4(texture(texture_metallic, frag_tex_coord).r, texture(texture_roughness, frag_tex_coord).r, texture(texture_ao, frag_tex_coord).r, 1.0);
 }
@@ -7,6 +7,11 @@ layout (binding = 0) uniform ubo_t
     mat4 projection;
 } ubo;
 
+layout (std430, binding = 8) readonly buffer instances_t
+{
+    mat4 instances[];
+};
+
 layout (location = 0) in vec3 pos;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec3 tangent;
@@ -19,12 +24,13 @@ layout (location = 3) out mat3 frag_TBN;
 
 void main()
 {
-    gl_Position = ubo.projection * ubo.view * ubo.model * vec4(pos, 1.0);
-    frag_pos = vec3(ubo.model * vec4(pos, 1.0));
+    mat4 model = ubo.model * instances[gl_InstanceIndex];
+    gl_Position = ubo.projection * ubo.view * model * vec4(pos, 1.0);
+    frag_pos = vec3(model * vec4(pos, 1.0));
     frag_tex_coord = tex_coord;
-    frag_normal = tangent;//mat3(transpose(inverse(ubo.model))) * normal;
+    frag_normal = tangent;//mat3(transpose(inverse(model))) * normal;
 
-    mat3 normal_matrix = transpose(inverse(mat3(ubo.model)));
+    mat3 normal_matrix = transpose(inverse(mat3(model)));
 
     vec3 T = normalize(normal_matrix * tangent);
     vec3 N = normalize(normal_matrix * normal);
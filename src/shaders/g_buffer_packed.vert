@@ -0,0 +1,60 @@
+#version 450
+
+layout (binding = 0) uniform ubo_t
+{
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+} ubo;
+
+layout (std430, binding = 8) readonly buffer instances_t
+{
+    mat4 instances[];
+};
+
+layout (push_constant) uniform dequant_t
+{
+    vec4 offset;
+    vec4 scale;
+} dequant;
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec2 normal;
+layout (location = 2) in vec2 tangent;
+layout (location = 3) in vec2 tex_coord;
+
+layout (location = 0) out vec3 frag_pos;
+layout (location = 1) out vec3 frag_normal;
+layout (location = 2) out vec2 frag_tex_coord;
+layout (location = 3) out mat3 frag_TBN;
+
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+void main()
+{
+    mat4 model = ubo.model * instances[gl_InstanceIndex];
+    vec3 object_pos = dequant.offset.xyz + dequant.scale.xyz * pos;
+    vec3 object_normal = octahedral_decode(normal);
+    vec3 object_tangent = octahedral_decode(tangent);
+
+    gl_Position = ubo.projection * ubo.view * model * vec4(object_pos, 1.0);
+    frag_pos = vec3(model * vec4(object_pos, 1.0));
+    frag_tex_coord = tex_coord;
+    frag_normal = object_tangent;
+
+    mat3 normal_matrix = transpose(inverse(mat3(model)));
+
+    vec3 T = normalize(normal_matrix * object_tangent);
+    vec3 N = normalize(normal_matrix * object_normal);
+    T = normalize(T - dot(T, N) * N);
+    vec3 B = cross(N, T);
+    frag_TBN = mat3(T, B, N);
+}
@@ -2,7 +2,7 @@
 
 layout (location = 0) in vec2 frag_tex_coord;
 
-layout (input_attachment_index = 0, binding = 0) uniform subpassInput g_pos;
+layout (input_attachment_index = 0, binding = 0) uniform subpassInput g_depth;
 layout (input_attachment_index = 1, binding = 1) uniform subpassInput g_normal;
 layout (input_attachment_index = 2, binding = 2) uniform subpassInput g_albedo;
 layout (input_attachment_index = 3, binding = 3) uniform subpassInput g_pbr;
@@ -17,22 +17,57 @@ layout (binding = 4) uniform light_t
     float linear;
     float quadratic;
     float far_plane;
+    float near_plane;
 } light;
 
 layout (binding = 5) uniform view_t
 {
     vec3 pos;
     mat4 mat;
+    mat4 inverse_view_projection;
+    vec2 extent;
 } view;
 
-layout (binding = 6) uniform samplerCube shadow_map;
+layout (binding = 6) uniform samplerCubeShadow shadow_map;
+
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+struct point_light_t
+{
+    vec4 position;
+    vec4 color;
+};
+
+layout (binding = 7) uniform light_cluster_params_t
+{
+    mat4 view;
+    mat4 inverse_projection;
+    vec4 screen;
+    uint light_count;
+} cluster_params;
+
+layout (std430, binding = 8) readonly buffer lights_t
+{
+    point_light_t lights[];
+};
+
+layout (std430, binding = 9) readonly buffer clusters_t
+{
+    uint clusters[];
+};
 
 layout (location = 0) out vec4 out_color;
 
 const float PI = 3.14159265359;
 
 vec3 calc_point_light(vec3 pos, vec3 normal, vec3 diffuse, float metallic, float roughness, vec3 F0);
+vec3 calc_clustered_lights(vec3 pos, vec3 normal, vec3 albedo, float metallic, float roughness, vec3 F0);
+vec3 calc_radiance(vec3 pos, vec3 normal, vec3 albedo, float metallic, float roughness, vec3 F0, vec3 light_pos, vec3 radiance);
 float point_shadow(vec3 light_pos, vec3 pos, float far_plane);
+vec3 octahedral_decode(vec2 e);
 
 float distribution_ggx(vec3 n, vec3 h, float roughness);
 float geometry_schlick_ggx(float nv, float roughness);
@@ -41,8 +76,13 @@ vec3 fresnel_schlick(float cos_theta, vec3 f0);
 
 void main()
 {
-    vec3 frag_pos = subpassLoad(g_pos).rgb;
-    vec3 normal   = subpassLoad(g_normal).rgb;
+    float depth = subpassLoad(g_depth).r;
+    // the sky has no surface to light
+    if (depth >= 1.0) discard;
+    vec4 clip_pos = vec4(gl_FragCoord.xy / view.extent * 2.0 - 1.0, depth, 1.0);
+    vec4 world_pos = view.inverse_view_projection * clip_pos;
+    vec3 frag_pos = world_pos.xyz / world_pos.w;
+    vec3 normal   = octahedral_decode(subpassLoad(g_normal).rg);
     vec3 diffuse  = subpassLoad(g_albedo).rgb;
     vec3 pbr      = subpassLoad(g_pbr).rgb;
 
@@ -51,6 +91,7 @@ void main()
     vec3 Lo = vec3(0.0);
 
     Lo += calc_point_light(frag_pos, normal, diffuse, pbr.r, pbr.g, F0);
+    Lo += calc_clustered_lights(frag_pos, normal, diffuse, pbr.r, pbr.g, F0);
 
     Lo += diffuse * light.ambient * pbr.b;
 
@@ -59,26 +100,58 @@ void main()
 
 float point_shadow(vec3 pos, float far_plane)
 {
-    float bias = 0.05;
     vec3 frag_to_light = (pos - light.pos);
+    // a cube face stores the projected depth along its major axis
+    vec3 axis_dist = abs(frag_to_light);
+    float z = max(axis_dist.x, max(axis_dist.y, axis_dist.z));
+    float current_depth = far_plane * (z - light.near_plane) / (z * (far_plane - light.near_plane));
     frag_to_light.y *= -1;
-    float current_depth = length(frag_to_light);
-    float closest_depth = texture(shadow_map, frag_to_light).r;
-    float shadow = (current_depth - bias > closest_depth) ? 1.0 : 0.0;
-    return shadow;
+    // the comparison sampler filters the 2x2 compare results (PCF)
+    return 1.0 - texture(shadow_map, vec4(frag_to_light, current_depth));
 }
 
 vec3 calc_point_light(vec3 pos, vec3 normal, vec3 albedo, float metallic, float roughness, vec3 F0)
 {
-    vec3 v = normalize(view.pos - pos);
-    vec3 l = normalize(light.pos - pos);
-    vec3 h = normalize(l + v);
-
     float dist = length(light.pos - pos);
     float attenuation = 1.0 / (dist * dist);
 
     vec3 radiance = light.color * attenuation;
 
+    float shadow = point_shadow(pos, light.far_plane);
+    return (1.0 - shadow) * calc_radiance(pos, normal, albedo, metallic, roughness, F0, light.pos, radiance);
+}
+
+vec3 calc_clustered_lights(vec3 pos, vec3 normal, vec3 albedo, float metallic, float roughness, vec3 F0)
+{
+    // the froxel of the pixel, the slices split the view depth exponentially like in light_clusters.comp
+    float depth = -(view.mat * vec4(pos, 1.0)).z;
+    float near_plane = cluster_params.screen.z;
+    float far_plane = cluster_params.screen.w;
+    if (depth < near_plane || depth > far_plane) return vec3(0.0);
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / cluster_params.screen.xy * vec2(CLUSTERS_X, CLUSTERS_Y)), uvec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+    uint slice = min(uint(log(depth / near_plane) / log(far_plane / near_plane) * CLUSTERS_Z), uint(CLUSTERS_Z - 1));
+    uint base = ((slice * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x) * (MAX_LIGHTS_PER_CLUSTER + 1);
+
+    vec3 Lo = vec3(0.0);
+    uint count = clusters[base];
+    for (uint i = 0; i < count; ++i)
+    {
+        point_light_t point_light = lights[clusters[base + 1 + i]];
+        float dist = length(point_light.position.xyz - pos);
+        // the window takes the inverse square falloff to zero at the radius the light was binned with
+        float window = clamp(1.0 - pow(dist / point_light.position.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 0.0001);
+        Lo += calc_radiance(pos, normal, albedo, metallic, roughness, F0, point_light.position.xyz, point_light.color.rgb * attenuation);
+    }
+    return Lo;
+}
+
+vec3 calc_radiance(vec3 pos, vec3 normal, vec3 albedo, float metallic, float roughness, vec3 F0, vec3 light_pos, vec3 radiance)
+{
+    vec3 v = normalize(view.pos - pos);
+    vec3 l = normalize(light_pos - pos);
+    vec3 h = normalize(l + v);
+
     float NDF = distribution_ggx(normal, h, roughness);
     float G = geometry_smith(normal, v, l, roughness);
     vec3 F = fresnel_schlick(max(dot(h, v), 0.0), F0);
@@ -92,8 +165,17 @@ vec3 calc_point_light(vec3 pos, vec3 normal, vec3 albedo, float metallic, float
     kD *= 1.0 - metallic;
 
     float nl = max(dot(normal, l), 0.0);
-    float shadow = point_shadow(pos, light.far_plane);
-    return (1.0 - shadow) * ((kD * albedo / PI + specular) * radiance * nl);
+    return (kD * albedo / PI + specular) * radiance * nl;
+}
+
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
 }
 
 float distribution_ggx(vec3 n, vec3 h, float roughness)
@@ -0,0 +1,38 @@
+#version 450
+#extension GL_EXT_multiview : enable
+
+layout (location = 0) in vec3 pos;
+
+layout (binding = 0) uniform ubo_t
+{
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+    vec3 pos;
+    mat4 face_views[6];
+} ubo;
+
+layout (std430, binding = 1) readonly buffer instances_t
+{
+    mat4 instances[];
+};
+
+layout (push_constant) uniform push_const_t
+{
+    uint face;
+    uint face_mask;
+    vec4 offset;
+    vec4 scale;
+} push_const;
+
+void main()
+{
+    // multiview broadcasts every draw to all faces, faces the caster does not touch get clipped geometry
+    if ((push_const.face_mask & (1u << (push_const.face + gl_ViewIndex))) == 0u)
+    {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+    vec3 object_pos = push_const.offset.xyz + push_const.scale.xyz * pos;
+    gl_Position = ubo.projection * ubo.face_views[push_const.face + gl_ViewIndex] * ubo.model * instances[gl_InstanceIndex] * vec4(object_pos, 1.0);
+}
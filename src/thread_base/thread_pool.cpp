@@ -0,0 +1,68 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+void thread_pool_t::worker_loop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->condition.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+            if (this->stopping && this->tasks.empty())
+            {
+                return;
+            }
+            task = std::move(this->tasks.front());
+            this->tasks.pop();
+        }
+        task();
+    }
+}
+
+void thread_pool_t::parallel_for(std::uint32_t count, std::function<void(std::uint32_t)> func)
+{
+    std::uint32_t chunks = std::min(count, get_thread_count());
+    std::vector<std::future<void>> results;
+    results.reserve(chunks);
+    for (std::uint32_t c = 0; c < chunks; ++c)
+    {
+        std::uint32_t begin = count * c / chunks;
+        std::uint32_t end = count * (c + 1) / chunks;
+        results.push_back(submit([begin, end, &func]() { for (std::uint32_t i = begin; i < end; ++i) func(i); }));
+    }
+    for (std::future<void>& result : results)
+    {
+        result.get();
+    }
+}
+
+std::uint32_t thread_pool_t::get_thread_count() const
+{
+    return static_cast<std::uint32_t>(this->workers.size());
+}
+
+thread_pool_t::thread_pool_t(std::uint32_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::uint32_t i = 0; i < thread_count; ++i)
+    {
+        this->workers.emplace_back(&thread_pool_t::worker_loop, this);
+    }
+}
+
+thread_pool_t::~thread_pool_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->condition.notify_all();
+    for (std::thread& worker : this->workers)
+    {
+        worker.join();
+    }
+}
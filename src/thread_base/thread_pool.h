@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class thread_pool_t
+{
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping = false;
+
+        void worker_loop();
+
+    public:
+        template<typename F>
+        auto submit(F&& func) -> std::future<decltype(func())>
+        {
+            using result_t = decltype(func());
+            std::shared_ptr<std::packaged_task<result_t()>> task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(func));
+            std::future<result_t> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->tasks.emplace([task]() { (*task)(); });
+            }
+            this->condition.notify_one();
+            return result;
+        }
+
+        void parallel_for(std::uint32_t count, std::function<void(std::uint32_t)> func);
+        std::uint32_t get_thread_count() const;
+        thread_pool_t(std::uint32_t thread_count = 0);
+        ~thread_pool_t();
+};
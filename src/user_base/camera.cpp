@@ -8,6 +8,8 @@ camera_t::camera_t(glm::vec3 position, glm::vec3 up, float yaw, float pitch)
     this->yaw = yaw;
     this->pitch = pitch;
     this->fov_angle = 45.0f;
+    this->near_plane = 0.1f;
+    this->far_plane = 100.0f;
     this->speed = 2.5f;
     this->sensitivity = 0.1f;
     this->front = glm::vec3(0.0f, 0.0f, -1.0f);
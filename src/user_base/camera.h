@@ -27,6 +27,8 @@ struct camera_t
         float speed;
         float sensitivity;
         float fov_angle;
+        float near_plane;
+        float far_plane;
 
         glm::mat4 calculate_view_matrix();
         void move(camera_movement_t direction, float delta_time);
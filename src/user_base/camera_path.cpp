@@ -0,0 +1,26 @@
+#include "camera_path.h"
+#include <cmath>
+
+void camera_path_t::apply(camera_t& cam, glm::vec3& light_pos, std::uint32_t frame) const
+{
+    float t = (this->frame_count > 1) ? static_cast<float>(frame) / static_cast<float>(this->frame_count - 1) : 0.0f;
+
+    float camera_angle = glm::radians(360.0f * this->camera_revolutions * t);
+    cam.position = this->target + glm::vec3(
+            this->camera_radius * std::sin(camera_angle),
+            this->camera_height,
+            this->camera_radius * std::cos(camera_angle)
+            );
+
+    glm::vec3 dir = glm::normalize(this->target - cam.position);
+    cam.yaw = glm::degrees(std::atan2(dir.z, dir.x));
+    cam.pitch = glm::degrees(std::asin(dir.y));
+    cam.turn(0.0f, 0.0f);
+
+    float light_angle = glm::radians(360.0f * this->light_revolutions * t);
+    light_pos = this->light_center + glm::vec3(
+            this->light_radius * std::cos(light_angle),
+            0.0f,
+            this->light_radius * std::sin(light_angle)
+            );
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "camera.h"
+#include <cstdint>
+
+struct camera_path_t
+{
+    glm::vec3 target = glm::vec3(0.0f);
+    float camera_radius = 6.0f;
+    float camera_height = 1.0f;
+    float camera_revolutions = 1.0f;
+
+    glm::vec3 light_center = glm::vec3(0.0f, 2.0f, 0.0f);
+    float light_radius = 3.0f;
+    float light_revolutions = 2.0f;
+
+    std::uint32_t frame_count = 1;
+
+    void apply(camera_t& cam, glm::vec3& light_pos, std::uint32_t frame) const;
+};
@@ -0,0 +1,107 @@
+#include "shadow_cache.h"
+#include "glm/ext/matrix_transform.hpp"
+#include <algorithm>
+#include <cmath>
+
+glm::mat4 cube_face_view(const glm::vec3& pos, std::uint32_t face)
+{
+    switch (face)
+    {
+        case 0: // POSITIVE_X
+            return glm::lookAt(pos, pos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        case 1:	// NEGATIVE_X
+            return glm::lookAt(pos, pos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        case 2:	// POSITIVE_Y
+            return glm::lookAt(pos, pos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+        case 3:	// NEGATIVE_Y
+            return glm::lookAt(pos, pos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        case 4:	// POSITIVE_Z
+            return glm::lookAt(pos, pos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        case 5:	// NEGATIVE_Z
+            return glm::lookAt(pos, pos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    }
+    return glm::mat4(1.0f);
+}
+
+shadow_caster_t calculate_bounding_sphere(const std::vector<glm::vec3>& positions)
+{
+    shadow_caster_t caster;
+    if (positions.empty()) return caster;
+
+    glm::vec3 min = positions[0], max = positions[0];
+    for (const glm::vec3& pos : positions)
+    {
+        min = glm::min(min, pos);
+        max = glm::max(max, pos);
+    }
+    caster.center = (min + max) * 0.5f;
+    for (const glm::vec3& pos : positions)
+    {
+        caster.radius = std::max(caster.radius, glm::length(pos - caster.center));
+    }
+
+    return caster;
+}
+
+std::uint32_t get_caster_faces(const glm::vec3& light_pos, float far_plane, const shadow_caster_t& caster)
+{
+    // the transform may scale, so the radius grows with the largest axis
+    glm::vec3 center = glm::vec3(caster.transform * glm::vec4(caster.center, 1.0f)) - light_pos;
+    float scale = std::max({ glm::length(glm::vec3(caster.transform[0])), glm::length(glm::vec3(caster.transform[1])), glm::length(glm::vec3(caster.transform[2])) });
+    float radius = caster.radius * scale;
+    if (glm::length(center) - radius > far_plane) return 0;
+
+    // every face is a 90 degree frustum, bounded by the four planes halfway between its forward axis and its side axes
+    std::uint32_t faces = 0;
+    for (std::uint32_t i = 0; i < 6; ++i)
+    {
+        glm::mat4 view = cube_face_view(glm::vec3(0.0f), i);
+        glm::vec3 right = glm::vec3(view[0][0], view[1][0], view[2][0]);
+        glm::vec3 up = glm::vec3(view[0][1], view[1][1], view[2][1]);
+        glm::vec3 forward = -glm::vec3(view[0][2], view[1][2], view[2][2]);
+
+        bool inside = true;
+        for (const glm::vec3& side : { right, -right, up, -up })
+        {
+            glm::vec3 normal = (forward + side) / std::sqrt(2.0f);
+            if (glm::dot(normal, center) < -radius)
+            {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) faces |= 1u << i;
+    }
+
+    return faces;
+}
+
+std::uint32_t shadow_cache_t::update(const glm::vec3& light_pos, float far_plane, const std::vector<shadow_caster_t>& casters)
+{
+    bool light_moved = !this->light_pos.has_value() || this->light_pos.value() != light_pos || this->far_plane != far_plane;
+    if (!this->enabled || light_moved || this->casters.size() != casters.size())
+    {
+        this->dirty_faces = SHADOW_ALL_FACES;
+    }
+    this->light_pos = light_pos;
+    this->far_plane = far_plane;
+
+    // a moved caster leaves stale depth where it was and is missing where it is now
+    if (this->dirty_faces != SHADOW_ALL_FACES)
+    {
+        for (std::uint32_t i = 0; i < casters.size(); ++i)
+        {
+            if (this->casters[i].transform == casters[i].transform && this->casters[i].center == casters[i].center
+                    && this->casters[i].radius == casters[i].radius) continue;
+            this->dirty_faces |= get_caster_faces(light_pos, far_plane, this->casters[i]) | get_caster_faces(light_pos, far_plane, casters[i]);
+        }
+    }
+    this->casters = casters;
+
+    return this->dirty_faces;
+}
+
+void shadow_cache_t::commit(std::uint32_t faces)
+{
+    this->dirty_faces &= ~faces;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+constexpr std::uint32_t SHADOW_ALL_FACES = 0b111111;
+
+struct shadow_caster_t
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    glm::mat4 transform = glm::mat4(1.0f);
+};
+
+/// Tracks which faces of a point light shadow cube need to be re-rendered, faces are only invalidated by casters whose bounds touch them.
+class shadow_cache_t
+{
+    private:
+        std::optional<glm::vec3> light_pos;
+        float far_plane = 0.0f;
+        std::vector<shadow_caster_t> casters;
+        std::uint32_t dirty_faces = SHADOW_ALL_FACES;
+
+    public:
+        bool enabled = true;
+
+        /// Returns the faces that are out of date, they stay dirty until commit so a frame that is never recorded does not lose them.
+        std::uint32_t update(const glm::vec3& light_pos, float far_plane, const std::vector<shadow_caster_t>& casters);
+        /// Marks faces as up to date once their shadow passes have been recorded.
+        void commit(std::uint32_t faces);
+};
+
+glm::mat4 cube_face_view(const glm::vec3& pos, std::uint32_t face);
+std::uint32_t get_caster_faces(const glm::vec3& light_pos, float far_plane, const shadow_caster_t& caster);
+shadow_caster_t calculate_bounding_sphere(const std::vector<glm::vec3>& positions);
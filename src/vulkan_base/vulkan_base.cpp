@@ -2,6 +2,7 @@
 #include "vulkan_constants.h"
 #include "vulkan_queue_family_indices.h"
 #include "vulkan_validation_layers.h"
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <iostream>
@@ -10,13 +11,17 @@
 
 #include "debug_print.h"
 
-std::vector<const char*> get_required_extensions()
+std::vector<const char*> get_required_extensions(bool headless)
 {
-    std::uint32_t glfw_ext_count = 0;
-    const char** p_glfw_exts;
+    std::vector<const char*> glfw_exts;
+    if (!headless)
+    {
+        std::uint32_t glfw_ext_count = 0;
+        const char** p_glfw_exts;
 
-    p_glfw_exts = glfwGetRequiredInstanceExtensions(&glfw_ext_count);
-    std::vector<const char*> glfw_exts(p_glfw_exts, p_glfw_exts + glfw_ext_count);
+        p_glfw_exts = glfwGetRequiredInstanceExtensions(&glfw_ext_count);
+        glfw_exts.assign(p_glfw_exts, p_glfw_exts + glfw_ext_count);
+    }
 #ifdef PORTABILITY
     glfw_exts.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
 #endif
@@ -48,7 +53,7 @@ std::int32_t vulkan_context_t::create_instance(std::string name)
     create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     create_info.pApplicationInfo = &app_info;
 
-    std::vector<const char*> glfw_exts = get_required_extensions();
+    std::vector<const char*> glfw_exts = get_required_extensions(this->headless);
 
     create_info.enabledExtensionCount = glfw_exts.size();
     create_info.ppEnabledExtensionNames = glfw_exts.data();
@@ -119,14 +124,14 @@ std::int32_t vulkan_context_t::create_instance(std::string name)
     return 0;
 }
 
-bool check_physical_device_extension_support(VkPhysicalDevice physical_device)
+bool check_physical_device_extension_support(VkPhysicalDevice physical_device, const std::vector<const char*>& extensions)
 {
     std::uint32_t ext_count = 0;
     vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &ext_count, nullptr);
     std::vector<VkExtensionProperties> available_extensions(ext_count);
     vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &ext_count, available_extensions.data());
    
-    std::set<std::string> required_extensions(device_extensions.begin(), device_extensions.end());
+    std::set<std::string> required_extensions(extensions.begin(), extensions.end());
     for (const VkExtensionProperties& ext : available_extensions)
     {
         required_extensions.erase(ext.extensionName);
@@ -180,7 +185,8 @@ std::uint32_t rate_device_suitablity(const VkPhysicalDevice& physical_device, Vk
         return 0;
     }
 
-    bool exts_supported = check_physical_device_extension_support(physical_device);
+    bool headless = (surface == VK_NULL_HANDLE);
+    bool exts_supported = check_physical_device_extension_support(physical_device, (headless) ? headless_device_extensions : device_extensions);
 
     queue_family_indices_t indices(physical_device, surface);
     if (!indices.is_complete() || !exts_supported)
@@ -188,6 +194,11 @@ std::uint32_t rate_device_suitablity(const VkPhysicalDevice& physical_device, Vk
         return 0;
     }
 
+    if (headless)
+    {
+        return score;
+    }
+
     swap_chain_t swap_chain(physical_device, surface);
     if (!swap_chain.is_adequate())
     {
@@ -250,6 +261,11 @@ std::int32_t vulkan_context_t::pick_physical_device()
 
 std::int32_t vulkan_context_t::create_surface()
 {
+    if (this->headless)
+    {
+        this->surface = VK_NULL_HANDLE;
+        return 0;
+    }
     if (glfwCreateWindowSurface(this->instance, this->window, nullptr, &(this->surface)) != VK_SUCCESS)
     {
         std::cerr << "Failed to create window surface!" << std::endl;
@@ -365,6 +381,10 @@ std::int32_t vulkan_context_t::recreate_swap_chain()
     {
         this->depth_buffers[idx] = new image_t(&this->physical_device, &this->command_pool);
         this->depth_buffers[idx]->init_depth_buffer(settings, this->get_swap_chain_extent(), this->device);
+        if (this->depth_buffers[idx]->settings.usage & (VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT))
+        {
+            this->depth_buffers[idx]->transition_image_layout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        }
         ++idx;
     }
 
@@ -398,6 +418,24 @@ std::int32_t vulkan_context_t::add_pipeline(const pipeline_shaders_t& shaders, c
     return 0;
 }
 
+std::int32_t vulkan_context_t::add_compute_pipeline(const std::string& shader, std::uint32_t layout_index, const std::vector<VkPushConstantRange>& push_constant_ranges)
+{
+    if (layout_index >= this->descriptor_set_layouts.size())
+    {
+        std::cerr << "Failed to add compute pipeline, unknown layout!" << std::endl;
+        return -1;
+    }
+
+    compute_pipeline_t* pipeline = new compute_pipeline_t();
+    if (pipeline->init(shader, { this->descriptor_set_layouts[layout_index] }, push_constant_ranges, this->device) != 0)
+    {
+        delete pipeline;
+        return -1;
+    }
+    this->compute_pipelines.push_back(pipeline);
+    return 0;
+}
+
 std::int32_t vulkan_context_t::add_buffer(const buffer_settings_t& settings)
 {
     buffer_t* buffer = new buffer_t(&this->physical_device, &this->command_pool);
@@ -414,6 +452,43 @@ std::int32_t vulkan_context_t::add_image(const std::string& path, const image_se
     return 0;
 }
 
+std::int32_t vulkan_context_t::add_images(const std::vector<std::string>& paths, const image_settings_t& settings, bool flip)
+{
+    std::vector<std::future<std::optional<decoded_image_t>>> decoded_images;
+    for (const std::string& path : paths)
+    {
+        decoded_images.push_back(this->thread_pool->submit([path, flip]() { return decode_image(path, flip); }));
+    }
+
+    // uploads are recorded in order as soon as each decode finishes, and go out together with the next flush
+    std::int32_t res = 0;
+    for (std::future<std::optional<decoded_image_t>>& future : decoded_images)
+    {
+        std::optional<decoded_image_t> decoded = future.get();
+        if (!decoded.has_value())
+        {
+            res = -1;
+            continue;
+        }
+        if (res == 0)
+        {
+            image_t* image = new image_t(&this->physical_device, &this->command_pool);
+            if (image->init_texture(decoded.value(), settings, this->device) != 0)
+            {
+                delete image;
+                res = -1;
+            }
+            else
+            {
+                this->images.push_back(image);
+            }
+        }
+        free_decoded_image(decoded.value());
+    }
+
+    return res;
+}
+
 std::int32_t vulkan_context_t::add_descriptor_set_layout(const std::vector<VkDescriptorSetLayoutBinding> layout_bindings)
 {
     VkDescriptorSetLayout set_layout;
@@ -431,11 +506,27 @@ std::int32_t vulkan_context_t::add_descriptor_set_layout(const std::vector<VkDes
     }
 
     this->descriptor_set_layouts.push_back(set_layout);
+    this->descriptor_set_types.push_back(types);
     
     descriptor_pool_t* descriptor_pool = new descriptor_pool_t();
     if (descriptor_pool->init(this->descriptor_set_layouts.back(), types, &this->device->device) != 0) return -1;
     this->descriptor_pools.push_back(descriptor_pool);
     
+    return static_cast<std::int32_t>(this->descriptor_set_layouts.size() - 1);
+}
+
+// extra pools share an existing layout and are appended after the per pipeline pools, e.g. one per material
+std::int32_t vulkan_context_t::add_descriptor_pool(std::uint32_t layout_index)
+{
+    if (layout_index >= this->descriptor_set_layouts.size())
+    {
+        std::cerr << "Failed to add descriptor pool, unknown layout!" << std::endl;
+        return -1;
+    }
+
+    descriptor_pool_t* descriptor_pool = new descriptor_pool_t();
+    if (descriptor_pool->init(this->descriptor_set_layouts[layout_index], this->descriptor_set_types[layout_index], &this->device->device) != 0) return -1;
+    this->descriptor_pools.push_back(descriptor_pool);
     return 0;
 }
 
@@ -451,13 +542,51 @@ void vulkan_context_t::bind_descriptor_sets(VkCommandBuffer command_buffer, std:
             &this->descriptor_pools[pool_index]->sets[this->current_frame], 0, nullptr);
 }
 
+// unlike bind_descriptor_sets this does not touch current_pipeline, so it is safe to call while recording on worker threads
+void vulkan_context_t::bind_pipeline(VkCommandBuffer command_buffer, std::uint32_t pipeline_index, std::uint32_t first_set)
+{
+    graphics_pipeline_t* pipeline = this->graphics_pipelines[pipeline_index];
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline_layout, first_set, 1,
+            &this->descriptor_pools[pipeline_index]->sets[this->current_frame], 0, nullptr);
+}
+
+void vulkan_context_t::bind_descriptor_pool(VkCommandBuffer command_buffer, std::uint32_t pipeline_index, std::uint32_t pool_index, std::uint32_t first_set)
+{
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphics_pipelines[pipeline_index]->pipeline_layout, first_set, 1,
+            &this->descriptor_pools[pool_index]->sets[this->current_frame], 0, nullptr);
+}
+
+// compute pipelines have no pool of their own, the set comes from the pool created with their layout
+void vulkan_context_t::bind_compute_pipeline(VkCommandBuffer command_buffer, std::uint32_t pipeline_index, std::uint32_t pool_index)
+{
+    compute_pipeline_t* pipeline = this->compute_pipelines[pipeline_index];
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline_layout, 0, 1,
+            &this->descriptor_pools[pool_index]->sets[this->current_frame], 0, nullptr);
+}
+
+std::optional<std::vector<VkCommandBuffer>> vulkan_context_t::record_secondary(const std::vector<secondary_recording_t>& recordings)
+{
+    return this->secondary_command_buffers->record(recordings, this->thread_pool);
+}
+
 std::int32_t vulkan_context_t::draw_frame(std::function<void(VkCommandBuffer, std::uint32_t, vulkan_context_t*)> func)
 {
+    this->upload_context->flush();
+
+    std::chrono::time_point fence_start = std::chrono::high_resolution_clock::now();
     vkWaitForFences(this->device->device, 1, &this->sync_objects.in_flight[this->current_frame], VK_TRUE, UINT64_MAX);
+    std::chrono::time_point fence_end = std::chrono::high_resolution_clock::now();
+    this->frame_timings.fence_wait_ms = std::chrono::duration<double, std::milli>(fence_end - fence_start).count();
 
-    std::uint32_t image_index;
-    VkResult result = vkAcquireNextImageKHR(this->device->device, this->swap_chain->swap_chain, UINT64_MAX,
-            this->sync_objects.image_available[this->current_frame], VK_NULL_HANDLE, &image_index);
+    std::uint32_t image_index = this->current_frame;
+    VkResult result = VK_SUCCESS;
+    if (!this->headless)
+    {
+        result = vkAcquireNextImageKHR(this->device->device, this->swap_chain->swap_chain, UINT64_MAX,
+                this->sync_objects.image_available[this->current_frame], VK_NULL_HANDLE, &image_index);
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR)
     {
@@ -475,15 +604,23 @@ std::int32_t vulkan_context_t::draw_frame(std::function<void(VkCommandBuffer, st
 
     vkResetFences(this->device->device, 1, &this->sync_objects.in_flight[this->current_frame]);
     vkResetCommandBuffer(this->command_buffers->command_buffers[this->current_frame], 0);
+    this->secondary_command_buffers->begin_frame(this->current_frame);
 
     std::vector<VkCommandBuffer> command_buffers;
     
-    std::function<void(VkCommandBuffer)> draw_command = [&] (VkCommandBuffer command_buffer) { func(command_buffer, image_index, this); };
+    std::function<void(VkCommandBuffer)> draw_command = [&] (VkCommandBuffer command_buffer)
+    {
+        this->profiler->begin_frame(command_buffer, this->current_frame);
+        func(command_buffer, image_index, this);
+    };
 
+    std::chrono::time_point record_start = std::chrono::high_resolution_clock::now();
     if (this->command_buffers->record(this->current_frame, draw_command) != 0)
     {
         return -1;
     }
+    std::chrono::time_point record_end = std::chrono::high_resolution_clock::now();
+    this->frame_timings.record_ms = std::chrono::duration<double, std::milli>(record_end - record_start).count();
     command_buffers.push_back(this->command_buffers->command_buffers[this->current_frame]);
 
     VkSubmitInfo submit_info{};
@@ -491,7 +628,7 @@ std::int32_t vulkan_context_t::draw_frame(std::function<void(VkCommandBuffer, st
 
     VkSemaphore wait_semaphores[] = { this->sync_objects.image_available[this->current_frame] };
     VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submit_info.waitSemaphoreCount = 1;
+    submit_info.waitSemaphoreCount = (this->headless) ? 0 : 1;
     submit_info.pWaitSemaphores = wait_semaphores;
     submit_info.pWaitDstStageMask = wait_stages;
 
@@ -499,14 +636,27 @@ std::int32_t vulkan_context_t::draw_frame(std::function<void(VkCommandBuffer, st
     submit_info.pCommandBuffers = command_buffers.data();
 
     VkSemaphore signal_semaphores[] = { this->sync_objects.render_finished[this->current_frame] };
-    submit_info.signalSemaphoreCount = 1;
+    submit_info.signalSemaphoreCount = (this->headless) ? 0 : 1;
     submit_info.pSignalSemaphores = signal_semaphores;
 
+    std::chrono::time_point submit_start = std::chrono::high_resolution_clock::now();
     if (vkQueueSubmit(this->device->graphics_queue, 1, &submit_info, this->sync_objects.in_flight[this->current_frame]) != VK_SUCCESS)
     {
         std::cerr << "Failed to submit draw command buffer to queue!" << std::endl;
         return -1;
     }
+    std::chrono::time_point submit_end = std::chrono::high_resolution_clock::now();
+    this->frame_timings.submit_ms = std::chrono::duration<double, std::milli>(submit_end - submit_start).count();
+
+    this->last_frame = this->current_frame;
+    this->last_image_index = image_index;
+
+    if (this->headless)
+    {
+        this->frame_timings.present_ms = 0.0;
+        this->current_frame = (this->current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        return 0;
+    }
 
     VkPresentInfoKHR present_info{};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -519,7 +669,10 @@ std::int32_t vulkan_context_t::draw_frame(std::function<void(VkCommandBuffer, st
     present_info.pSwapchains = swap_chains;
     present_info.pImageIndices = &image_index;
 
+    std::chrono::time_point present_start = std::chrono::high_resolution_clock::now();
     result = vkQueuePresentKHR(this->device->present_queue, &present_info);
+    std::chrono::time_point present_end = std::chrono::high_resolution_clock::now();
+    this->frame_timings.present_ms = std::chrono::duration<double, std::milli>(present_end - present_start).count();
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || this->framebuffer_resized)
     {
@@ -540,20 +693,39 @@ std::int32_t vulkan_context_t::draw_frame(std::function<void(VkCommandBuffer, st
     return 0;
 }
 
+std::int32_t vulkan_context_t::read_back_frame(std::vector<std::uint8_t>& pixels)
+{
+    if (!this->headless)
+    {
+        std::cerr << "Reading back frames is only supported in headless mode!" << std::endl;
+        return -1;
+    }
+
+    vkWaitForFences(this->device->device, 1, &this->sync_objects.in_flight[this->last_frame], VK_TRUE, UINT64_MAX);
+
+    image_t* image = this->swap_chain->offscreen_images[this->last_image_index];
+    image->layout = this->swap_chain->final_layout;
+    return image->read_back(pixels);
+}
+
 void vulkan_context_t::main_loop(std::function<void()> func)
 {
     func();
     vkDeviceWaitIdle(this->device->device);
 }
 
-vulkan_context_t::vulkan_context_t(std::string name, std::uint32_t width, std::uint32_t height)
+vulkan_context_t::vulkan_context_t(std::string name, std::uint32_t width, std::uint32_t height, bool headless)
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    this->headless = headless;
+    if (!this->headless)
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-    this->window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
-    glfwSetWindowUserPointer(this->window, this);
-    glfwSetFramebufferSizeCallback(this->window, framebuffer_resize_callback);
+        this->window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
+        glfwSetWindowUserPointer(this->window, this);
+        glfwSetFramebufferSizeCallback(this->window, framebuffer_resize_callback);
+    }
 
     if (create_instance(name) != 0) return;
     if (ENABLE_VALIDATION_LAYERS)
@@ -571,10 +743,29 @@ vulkan_context_t::vulkan_context_t(std::string name, std::uint32_t width, std::u
     this->device = new logical_device_t(&(this->physical_device), this->surface);
     if (this->device->init() != 0) return;
     
+    if (create_command_pool() != 0) return;
+
+    this->thread_pool = new thread_pool_t();
+    this->secondary_command_buffers = new secondary_command_buffers_t();
+    if (this->secondary_command_buffers->init(&this->device->device, this->device->indices.graphics_family.value(), this->thread_pool->get_thread_count()) != 0) return;
+
+    this->upload_context = new upload_context_t();
+    if (this->upload_context->init(this->device, &this->physical_device) != 0) return;
+    this->device->upload_context = this->upload_context;
+
+    this->profiler = new gpu_profiler_t();
+    this->profiler->init(this->device, this->physical_device, MAX_FRAMES_IN_FLIGHT);
+
     this->swap_chain = new swap_chain_t(this->physical_device, this->surface);
-    if (this->swap_chain->init(this->device, this->surface, this->window) != 0) return;
+    if (this->headless)
+    {
+        if (this->swap_chain->init_offscreen(this->device, &this->physical_device, &this->command_pool, { width, height }, MAX_FRAMES_IN_FLIGHT) != 0) return;
+    }
+    else
+    {
+        if (this->swap_chain->init(this->device, this->surface, this->window) != 0) return;
+    }
 
-    if (create_command_pool() != 0) return;
     if (create_sync_objects() != 0) return;
 
     this->initialized = true;
@@ -582,6 +773,7 @@ vulkan_context_t::vulkan_context_t(std::string name, std::uint32_t width, std::u
 
 vulkan_context_t::~vulkan_context_t()
 {
+    delete this->upload_context;
 
     for (buffer_t* buf : this->buffers)
     {
@@ -618,6 +810,7 @@ vulkan_context_t::~vulkan_context_t()
     }
     DEBUG_PRINT("Destroying Sync Objects!");
     
+    delete this->secondary_command_buffers;
     vkDestroyCommandPool(this->device->device, this->command_pool, nullptr);
     DEBUG_PRINT("Destroying Command Pool!");
     
@@ -625,12 +818,19 @@ vulkan_context_t::~vulkan_context_t()
     {
         delete pipeline;
     }
+
+    for (compute_pipeline_t* pipeline : this->compute_pipelines)
+    {
+        delete pipeline;
+    }
     
     for (render_pass_t* render_pass : this->render_passes)
     {
         delete render_pass;
     }
     
+    delete this->profiler;
+    delete this->thread_pool;
     delete this->swap_chain;
     delete this->device;
 
@@ -639,11 +839,17 @@ vulkan_context_t::~vulkan_context_t()
         delete this->debug_messenger;
     }
 
-    vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
-    DEBUG_PRINT("Destroying Surface!");
+    if (!this->headless)
+    {
+        vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
+        DEBUG_PRINT("Destroying Surface!");
+    }
     vkDestroyInstance(this->instance, nullptr);
     DEBUG_PRINT("Destroying Instance!");
-    glfwDestroyWindow(this->window);
+    if (!this->headless)
+    {
+        glfwDestroyWindow(this->window);
+    }
     DEBUG_PRINT("Destroying Vulkan Context!");
 }
 
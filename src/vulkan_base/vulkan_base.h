@@ -7,22 +7,38 @@
 #include "vulkan_logical_device.h"
 #include "vulkan_swap_chain.h"
 #include "vulkan_graphics_pipeline.h"
+#include "vulkan_compute_pipeline.h"
 #include "vulkan_command_buffer.h"
 #include "vulkan_buffer.h"
 #include "vulkan_constants.h"
 #include "vulkan_descriptor_pool.h"
 #include "vulkan_image.h"
 #include "vulkan_render_pass.h"
+#include "vulkan_render_graph.h"
+#include "vulkan_profiler.h"
+#include "vulkan_upload_context.h"
+#include "thread_base/thread_pool.h"
 
 #include <string>
 
+struct frame_timings_t
+{
+    double fence_wait_ms = 0.0;
+    double record_ms = 0.0;
+    double submit_ms = 0.0;
+    double present_ms = 0.0;
+};
+
 class vulkan_context_t
 {
     private:
-        VkSurfaceKHR surface;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
         command_buffers_t* command_buffers = nullptr;
         std::uint32_t current_frame = 0;
+        std::uint32_t last_frame = 0;
+        std::uint32_t last_image_index = 0;
         std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
+        std::vector<std::vector<VkDescriptorType>> descriptor_set_types;
         std::vector<descriptor_pool_t*> descriptor_pools;
 
         struct
@@ -45,9 +61,10 @@ class vulkan_context_t
         static void framebuffer_resize_callback(GLFWwindow* window, std::int32_t width, std::int32_t height);
 
     public:
-        GLFWwindow* window;
+        GLFWwindow* window = nullptr;
         bool framebuffer_resized = false;
         bool initialized = false;
+        bool headless = false;
         VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
         VkInstance instance;
         VkPhysicalDevice physical_device = VK_NULL_HANDLE;
@@ -57,15 +74,25 @@ class vulkan_context_t
         std::vector<render_pass_t*> render_passes;
         std::vector<graphics_pipeline_t*> graphics_pipelines;
         graphics_pipeline_t* current_pipeline = nullptr;
+        std::vector<compute_pipeline_t*> compute_pipelines;
         std::vector<image_t*> color_buffers;
         std::vector<image_t*> depth_buffers;
         std::vector<buffer_t*> buffers;
         std::vector<image_t*> images;
+        frame_timings_t frame_timings;
+        gpu_profiler_t* profiler = nullptr;
+        upload_context_t* upload_context = nullptr;
+        thread_pool_t* thread_pool = nullptr;
+        secondary_command_buffers_t* secondary_command_buffers = nullptr;
 
+        /// Returns the index of the new layout or -1, the pool created with it is the last one in get_descriptor_pools.
         std::int32_t add_descriptor_set_layout(const std::vector<VkDescriptorSetLayoutBinding> layout_bindings = { UBO_LAYOUT_BINDING, SAMPLER_LAYOUT_BINDING });
+        std::int32_t add_descriptor_pool(std::uint32_t layout_index);
         std::int32_t add_pipeline(const pipeline_shaders_t& shaders, const pipeline_settings_t& settings);
+        std::int32_t add_compute_pipeline(const std::string& shader, std::uint32_t layout_index, const std::vector<VkPushConstantRange>& push_constant_ranges = {});
         std::int32_t add_buffer(const buffer_settings_t& settings);
         std::int32_t add_image(const std::string& path, const image_settings_t& settings, bool flip = false);
+        std::int32_t add_images(const std::vector<std::string>& paths, const image_settings_t& settings, bool flip = false);
         std::optional<VkFramebuffer> add_framebuffer(VkRenderPass render_passs, std::vector<VkImageView> attachemnts);
         buffer_t* get_buffer(std::uint32_t index);
         buffer_t* get_last_buffer();
@@ -75,12 +102,17 @@ class vulkan_context_t
         std::uint32_t get_current_frame();
         std::vector<descriptor_pool_t*>* get_descriptor_pools();
         void bind_descriptor_sets(VkCommandBuffer command_buffer, std::uint32_t pool_index, std::uint32_t first_set);
+        void bind_pipeline(VkCommandBuffer command_buffer, std::uint32_t pipeline_index, std::uint32_t first_set = 0);
+        void bind_descriptor_pool(VkCommandBuffer command_buffer, std::uint32_t pipeline_index, std::uint32_t pool_index, std::uint32_t first_set = 0);
+        void bind_compute_pipeline(VkCommandBuffer command_buffer, std::uint32_t pipeline_index, std::uint32_t pool_index);
+        std::optional<std::vector<VkCommandBuffer>> record_secondary(const std::vector<secondary_recording_t>& recordings);
         
         std::int32_t draw_frame(std::function<void(VkCommandBuffer, std::uint32_t, vulkan_context_t*)>);
+        std::int32_t read_back_frame(std::vector<std::uint8_t>& pixels);
         void main_loop(std::function<void()> func);
         VkExtent2D get_swap_chain_extent();
-        vulkan_context_t(std::string name, std::uint32_t width = 1920, std::uint32_t height = 1080);
+        vulkan_context_t(std::string name, std::uint32_t width = 1920, std::uint32_t height = 1080, bool headless = false);
         ~vulkan_context_t();
 };
 
-std::vector<const char*> get_required_extensions();
+std::vector<const char*> get_required_extensions(bool headless = false);
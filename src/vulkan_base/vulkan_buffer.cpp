@@ -1,5 +1,5 @@
 #include "vulkan_buffer.h"
-#include "vulkan_command_buffer.h"
+#include "vulkan_upload_context.h"
 #include "vulkan_vertex.h"
 #include <cstring>
 #include <iostream>
@@ -11,7 +11,6 @@ void buffer_settings_t::populate_defaults(std::uint32_t nr_vertices, VkBufferUsa
     this->size = sizeof(vertex_t) * nr_vertices;
     this->usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage;
     this->sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-    this->memory_offset = 0;
     this->map_memory_flags = 0;
 }
 
@@ -31,7 +30,7 @@ std::optional<std::uint32_t> find_memory_type(std::uint32_t type_filter, VkPhysi
     return std::nullopt;
 }
 
-std::int32_t buffer_t::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory)
+std::int32_t buffer_t::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, memory_allocation_t& allocation)
 {
     VkBufferCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -48,39 +47,20 @@ std::int32_t buffer_t::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage
     VkMemoryRequirements mem_requirements;
     vkGetBufferMemoryRequirements(this->device->device, buffer, &mem_requirements);
 
-    VkMemoryAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = mem_requirements.size;
-    std::optional<std::uint32_t> idx = find_memory_type(mem_requirements.memoryTypeBits, *this->physical_device, properties);
-    if (!idx.has_value())
-    {
-        std::cerr << "Failed to find suitable memory type!" << std::endl;
-        return -1;
-    }
-    alloc_info.memoryTypeIndex = idx.value();
-
-    if (vkAllocateMemory(this->device->device, &alloc_info, nullptr, &memory) != VK_SUCCESS)
+    std::optional<memory_allocation_t> opt_allocation = this->device->memory_allocator->allocate(mem_requirements, properties);
+    if (!opt_allocation.has_value())
     {
         std::cerr << "Failed to allocate buffer memory!" << std::endl;
+        vkDestroyBuffer(this->device->device, buffer, this->allocator);
         return -1;
     }
+    allocation = opt_allocation.value();
 
-    vkBindBufferMemory(this->device->device, buffer, memory, this->settings->memory_offset);
+    vkBindBufferMemory(this->device->device, buffer, allocation.memory, allocation.offset);
     
     return 0;
 }
 
-void buffer_t::copy_buffer(VkBuffer& src_buffer, VkBuffer& dst_buffer, VkDeviceSize size)
-{
-    VkCommandBuffer command_buffer = begin_single_time_commands(this->device->device, *this->command_pool);
-
-    VkBufferCopy copy_region{};
-    copy_region.size = size;
-    vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
-
-    end_single_time_commands(*this->command_pool, command_buffer, this->device->device, this->device->graphics_queue);
-}
-
 std::int32_t buffer_t::set_data(void* cpu_data)
 {
     if (this->device == nullptr)
@@ -89,16 +69,25 @@ std::int32_t buffer_t::set_data(void* cpu_data)
         return -1;
     }
     
-    vkMapMemory(this->device->device, this->memory, this->settings->memory_offset, this->settings->size, this->settings->map_memory_flags, &this->mapped_memory);
-    std::memcpy(this->mapped_memory, cpu_data, (std::size_t) this->settings->size);
-    vkUnmapMemory(this->device->device, this->memory);
+    if (this->allocation.mapped == nullptr)
+    {
+        std::cerr << "Buffer memory is not host visible!" << std::endl;
+        return -1;
+    }
+    std::memcpy(this->allocation.mapped, cpu_data, (std::size_t) this->settings->size);
 
     return 0;
 }
 
 void buffer_t::map_memory()
 {
-    vkMapMemory(this->device->device, this->memory, this->settings->memory_offset, this->settings->size, this->settings->map_memory_flags, &this->mapped_memory);
+    // host visible blocks stay mapped for their whole lifetime, so this only hands out the sub-range
+    if (this->allocation.mapped == nullptr)
+    {
+        std::cerr << "Buffer memory is not host visible!" << std::endl;
+        return;
+    }
+    this->mapped_memory = this->allocation.mapped;
 }
 
 std::int32_t buffer_t::set_staged_data(void* cpu_data)
@@ -109,25 +98,7 @@ std::int32_t buffer_t::set_staged_data(void* cpu_data)
         return -1;
     }
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_memory;
-    if (create_buffer(settings->size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                staging_buffer, staging_memory) != 0)
-    {
-        return -1;
-    }
-
-    void* gpu_data;
-    vkMapMemory(this->device->device, staging_memory, this->settings->memory_offset, this->settings->size, this->settings->map_memory_flags, &gpu_data);
-    std::memcpy(gpu_data, cpu_data, (std::size_t) this->settings->size);
-    vkUnmapMemory(this->device->device, staging_memory);
-
-    copy_buffer(staging_buffer, this->buffer, this->settings->size);
-
-    vkDestroyBuffer(this->device->device, staging_buffer, this->allocator);
-    vkFreeMemory(this->device->device, staging_memory, nullptr);
-
-    return 0;
+    return this->device->upload_context->upload_buffer(this->buffer, cpu_data, this->settings->size);
 }
 
 std::int32_t buffer_t::init(const buffer_settings_t& settings, const logical_device_t* device)
@@ -135,11 +106,12 @@ std::int32_t buffer_t::init(const buffer_settings_t& settings, const logical_dev
     this->device = device;
     this->settings = &settings;
 
-    if (create_buffer(settings.size, settings.usage, settings.memory_properties, this->buffer, this->memory) != 0)
+    if (create_buffer(settings.size, settings.usage, settings.memory_properties, this->buffer, this->allocation) != 0)
     {
         this->device = nullptr;
         return -1;
     }
+    this->memory = this->allocation.memory;
 
     return 0;    
 }
@@ -155,7 +127,7 @@ buffer_t::~buffer_t()
     if (this->device == nullptr) return;
     vkDestroyBuffer(this->device->device, this->buffer, this->allocator);
     DEBUG_PRINT("Destroying Buffer!");
-    vkFreeMemory(this->device->device, this->memory, nullptr);
+    this->device->memory_allocator->free(this->allocation);
     DEBUG_PRINT("Freeing Buffer Memory!");
 }
 
@@ -11,7 +11,6 @@ struct buffer_settings_t
     VkBufferUsageFlags usage;
     VkMemoryPropertyFlags memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     VkSharingMode sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-    VkDeviceSize memory_offset = 0;
     VkMemoryMapFlags map_memory_flags = 0;
     std::uint32_t binding = 0;
 
@@ -27,12 +26,12 @@ class buffer_t
         const VkAllocationCallbacks* allocator = nullptr;
         const buffer_settings_t* settings;
 
-        std::int32_t create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory);
-        void copy_buffer(VkBuffer& src_buffer, VkBuffer& dst_buffer, VkDeviceSize size);
+        std::int32_t create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, memory_allocation_t& allocation);
 
     public:
         VkBuffer buffer;
         VkDeviceMemory memory;
+        memory_allocation_t allocation;
         void* mapped_memory = nullptr;
 
         std::int32_t set_data(void* cpu_data);
@@ -1,8 +1,12 @@
 #include "vulkan_command_buffer.h"
 #include "vulkan_constants.h"
 
+#include <algorithm>
+#include <future>
 #include <iostream>
 
+#include "debug_print.h"
+
 VkRenderPassBeginInfo populate_render_pass_begin_info(VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D extent, const std::vector<VkClearValue>& clear_colors)
 {
     VkRenderPassBeginInfo render_pass_info{};
@@ -62,6 +66,160 @@ command_buffers_t::command_buffers_t()
 command_buffers_t::~command_buffers_t()
 {}
 
+std::int32_t secondary_command_buffers_t::init(const VkDevice* device, std::uint32_t queue_family, std::uint32_t thread_count)
+{
+    this->device = device;
+    this->thread_count = std::max(1u, thread_count);
+    this->thread_data.resize(MAX_FRAMES_IN_FLIGHT * this->thread_count);
+
+    VkCommandPoolCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    create_info.queueFamilyIndex = queue_family;
+    for (thread_data_t& data : this->thread_data)
+    {
+        if (vkCreateCommandPool(*this->device, &create_info, this->allocator, &data.command_pool) != VK_SUCCESS)
+        {
+            std::cerr << "Failed to create secondary command pool!" << std::endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void secondary_command_buffers_t::begin_frame(std::uint32_t frame)
+{
+    // the fence of this frame has been waited on, so all of its secondary buffers can be recycled at once
+    this->current_frame = frame;
+    for (std::uint32_t i = 0; i < this->thread_count; ++i)
+    {
+        thread_data_t& data = this->thread_data[frame * this->thread_count + i];
+        vkResetCommandPool(*this->device, data.command_pool, 0);
+        data.used = 0;
+    }
+}
+
+std::optional<VkCommandBuffer> secondary_command_buffers_t::get_command_buffer(std::uint32_t thread)
+{
+    thread_data_t& data = this->thread_data[this->current_frame * this->thread_count + thread];
+    if (data.used == data.command_buffers.size())
+    {
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = data.command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer command_buffer;
+        if (vkAllocateCommandBuffers(*this->device, &alloc_info, &command_buffer) != VK_SUCCESS)
+        {
+            std::cerr << "Failed to allocate secondary command buffer!" << std::endl;
+            return std::nullopt;
+        }
+        data.command_buffers.push_back(command_buffer);
+    }
+
+    return data.command_buffers[data.used++];
+}
+
+std::int32_t secondary_command_buffers_t::record(std::uint32_t thread, const secondary_recording_t& recording, VkCommandBuffer& command_buffer)
+{
+    std::optional<VkCommandBuffer> opt_buffer = get_command_buffer(thread);
+    if (!opt_buffer.has_value())
+    {
+        return -1;
+    }
+    command_buffer = opt_buffer.value();
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = recording.render_pass;
+    inheritance_info.subpass = recording.subpass;
+    inheritance_info.framebuffer = recording.framebuffer;
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (recording.render_pass != VK_NULL_HANDLE)
+    {
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        std::cerr << "Failed to begin recording secondary command buffer!" << std::endl;
+        return -1;
+    }
+
+    recording.func(command_buffer);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+    {
+        std::cerr << "Failed to record secondary command buffer!" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+std::optional<std::vector<VkCommandBuffer>> secondary_command_buffers_t::record(const std::vector<secondary_recording_t>& recordings, thread_pool_t* thread_pool)
+{
+    std::vector<VkCommandBuffer> command_buffers(recordings.size(), VK_NULL_HANDLE);
+    std::uint32_t count = static_cast<std::uint32_t>(recordings.size());
+    std::uint32_t chunks = (thread_pool != nullptr) ? std::min({ count, this->thread_count, thread_pool->get_thread_count() }) : 1;
+
+    // every chunk runs on a single worker and owns the pool of its index, so no pool is touched by two threads
+    std::vector<std::future<std::int32_t>> results;
+    for (std::uint32_t c = 0; c < chunks; ++c)
+    {
+        std::uint32_t begin = count * c / chunks;
+        std::uint32_t end = count * (c + 1) / chunks;
+        auto record_chunk = [this, c, begin, end, &recordings, &command_buffers]()
+        {
+            for (std::uint32_t i = begin; i < end; ++i)
+            {
+                if (record(c, recordings[i], command_buffers[i]) != 0) return -1;
+            }
+            return 0;
+        };
+        if (chunks == 1)
+        {
+            if (record_chunk() != 0) return std::nullopt;
+        }
+        else
+        {
+            results.push_back(thread_pool->submit(record_chunk));
+        }
+    }
+
+    bool failed = false;
+    for (std::future<std::int32_t>& result : results)
+    {
+        failed |= result.get() != 0;
+    }
+    if (failed)
+    {
+        return std::nullopt;
+    }
+
+    return command_buffers;
+}
+
+secondary_command_buffers_t::secondary_command_buffers_t()
+{}
+
+secondary_command_buffers_t::~secondary_command_buffers_t()
+{
+    if (this->device == nullptr) return;
+    for (thread_data_t& data : this->thread_data)
+    {
+        vkDestroyCommandPool(*this->device, data.command_pool, this->allocator);
+    }
+    DEBUG_PRINT("Destroying Secondary Command Pools!");
+}
+
 VkCommandBuffer begin_single_time_commands(VkDevice device, VkCommandPool pool)
 {
     VkCommandBufferAllocateInfo alloc_info{};
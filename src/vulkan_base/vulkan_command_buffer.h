@@ -5,6 +5,7 @@
 #include <optional>
 #include <vector>
 #include <vulkan/vulkan_core.h>
+#include "thread_base/thread_pool.h"
 
 class command_buffers_t
 {
@@ -16,6 +17,42 @@ class command_buffers_t
         ~command_buffers_t();
 };
 
+struct secondary_recording_t
+{
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    std::uint32_t subpass = 0;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    std::function<void(VkCommandBuffer)> func;
+};
+
+class secondary_command_buffers_t
+{
+    private:
+        struct thread_data_t
+        {
+            VkCommandPool command_pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> command_buffers;
+            std::uint32_t used = 0;
+        };
+
+        const VkDevice* device = nullptr;
+        const VkAllocationCallbacks* allocator = nullptr;
+        std::uint32_t thread_count = 0;
+        std::uint32_t current_frame = 0;
+        // one pool per recording thread and frame in flight, indexed by frame * thread_count + thread
+        std::vector<thread_data_t> thread_data;
+
+        std::optional<VkCommandBuffer> get_command_buffer(std::uint32_t thread);
+        std::int32_t record(std::uint32_t thread, const secondary_recording_t& recording, VkCommandBuffer& command_buffer);
+
+    public:
+        std::int32_t init(const VkDevice* device, std::uint32_t queue_family, std::uint32_t thread_count);
+        void begin_frame(std::uint32_t frame);
+        std::optional<std::vector<VkCommandBuffer>> record(const std::vector<secondary_recording_t>& recordings, thread_pool_t* thread_pool);
+        secondary_command_buffers_t();
+        ~secondary_command_buffers_t();
+};
+
 VkRenderPassBeginInfo populate_render_pass_begin_info(VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D extent, const std::vector<VkClearValue>& clear_colors);
 VkCommandBuffer begin_single_time_commands(VkDevice device, VkCommandPool pool);
 void end_single_time_commands(VkCommandPool pool, VkCommandBuffer command_buffer, VkDevice device, VkQueue queue);
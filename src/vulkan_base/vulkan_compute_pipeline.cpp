@@ -0,0 +1,72 @@
+#include "vulkan_compute_pipeline.h"
+#include "vulkan_graphics_pipeline.h"
+#include <iostream>
+
+#include "debug_print.h"
+
+std::int32_t compute_pipeline_t::init(const std::string& shader, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts,
+        const std::vector<VkPushConstantRange>& push_constant_ranges, const logical_device_t* device)
+{
+    std::optional<std::vector<char>> code = read_file(shader);
+    if (!code.has_value()) return -1;
+
+    VkShaderModuleCreateInfo module_info{};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = code.value().size();
+    module_info.pCode = reinterpret_cast<const std::uint32_t*>(code.value().data());
+
+    VkShaderModule module;
+    if (vkCreateShaderModule(device->device, &module_info, nullptr, &module) != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create shader module!" << std::endl;
+        return -1;
+    }
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = static_cast<std::uint32_t>(descriptor_set_layouts.size());
+    pipeline_layout_info.pSetLayouts = descriptor_set_layouts.data();
+    pipeline_layout_info.pushConstantRangeCount = static_cast<std::uint32_t>(push_constant_ranges.size());
+    pipeline_layout_info.pPushConstantRanges = push_constant_ranges.data();
+
+    if (vkCreatePipelineLayout(device->device, &pipeline_layout_info, nullptr, &(this->pipeline_layout)) != VK_SUCCESS)
+    {
+        vkDestroyShaderModule(device->device, module, nullptr);
+        std::cerr << "Failed to create pipeline layout!" << std::endl;
+        return -1;
+    }
+
+    VkComputePipelineCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    create_info.stage.module = module;
+    create_info.stage.pName = "main";
+    create_info.layout = this->pipeline_layout;
+
+    VkResult res = vkCreateComputePipelines(device->device, VK_NULL_HANDLE, 1, &create_info, this->allocator, &(this->pipeline));
+    vkDestroyShaderModule(device->device, module, nullptr);
+    this->device = &(device->device);
+    if (res != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create compute pipeline!" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+compute_pipeline_t::compute_pipeline_t()
+{}
+
+compute_pipeline_t::~compute_pipeline_t()
+{
+    if (this->device == nullptr)
+    {
+        return;
+    }
+    vkDestroyPipeline(*(this->device), this->pipeline, this->allocator);
+    DEBUG_PRINT("Destroying Compute Pipeline!")
+    vkDestroyPipelineLayout(*(this->device), this->pipeline_layout, nullptr);
+    DEBUG_PRINT("Destroying Pipeline Layout!")
+}
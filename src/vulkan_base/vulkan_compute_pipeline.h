@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include "vulkan_logical_device.h"
+
+class compute_pipeline_t
+{
+    private:
+        const VkDevice* device = nullptr;
+        const VkAllocationCallbacks* allocator = nullptr;
+    public:
+        VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+
+        std::int32_t init(const std::string& shader, const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts,
+                const std::vector<VkPushConstantRange>& push_constant_ranges, const logical_device_t* device);
+        compute_pipeline_t();
+        ~compute_pipeline_t();
+};
@@ -47,6 +47,7 @@ void descriptor_pool_t::configure_descriptors(std::vector<std::tuple<std::uint32
                     img_iter++;
                     break;
                 case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
                     {
                         buffer_t* buf = *((buffer_t**) std::get<2>(e) + std::get<4>(e) * i);
                         VkDescriptorBufferInfo buffer_info{};
@@ -8,6 +8,7 @@
 #include <vulkan/vulkan_core.h>
 #include "vulkan_render_pass.h"
 #include "vulkan_logical_device.h"
+#include "vulkan_vertex.h"
 
 struct pipeline_shaders_t
 {
@@ -37,9 +38,12 @@ struct pipeline_settings_t
     std::uint32_t subpass = 0;
     std::vector<VkPushConstantRange> push_constant_ranges;
 
-    void populate_defaults(const std::vector<VkDescriptorSetLayout>& descriptor_set_layputs, render_pass_t* render_pass, std::uint32_t color_attachment_count = 1);
+    void populate_defaults(const std::vector<VkDescriptorSetLayout>& descriptor_set_layputs, render_pass_t* render_pass, std::uint32_t color_attachment_count = 1,
+            vertex_format_t vertex_format = VERTEX_FORMAT_FULL);
 };
 
+std::optional<std::vector<char>> read_file(const std::string& filename);
+
 class graphics_pipeline_t
 {
     private:
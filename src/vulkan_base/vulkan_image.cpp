@@ -1,7 +1,9 @@
 #include "vulkan_image.h"
 #include "vulkan_buffer.h"
 #include "vulkan_command_buffer.h"
+#include "vulkan_upload_context.h"
 #include <cmath>
+#include <cstring>
 #include <iostream>
 
 #include "debug_print.h"
@@ -11,6 +13,11 @@ bool has_stencil_component(VkFormat format)
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
+bool has_depth_component(VkFormat format)
+{
+    return format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D16_UNORM || has_stencil_component(format);
+}
+
 std::int32_t create_image_view(image_view_settings_t& settings)
 {
     VkImageViewCreateInfo create_info{};
@@ -34,7 +41,7 @@ std::int32_t create_image_view(image_view_settings_t& settings)
     return 0;
 }
 
-std::int32_t image_t::create_image(std::uint32_t width, std::uint32_t height, VkImage& image, VkDeviceMemory& memory)
+std::int32_t image_t::create_image(std::uint32_t width, std::uint32_t height, VkImage& image, memory_allocation_t& allocation)
 {
     VkImageCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -61,24 +68,23 @@ std::int32_t image_t::create_image(std::uint32_t width, std::uint32_t height, Vk
     VkMemoryRequirements mem_requirements;
     vkGetImageMemoryRequirements(this->device->device, image, &mem_requirements);
 
-    VkMemoryAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = mem_requirements.size;
-    std::optional<std::uint32_t> idx = find_memory_type(mem_requirements.memoryTypeBits, *this->physical_device, this->settings.properties);
-    if (!idx.has_value())
+    // only tile based gpus expose lazily allocated memory, everywhere else transient attachments stay in device local memory
+    VkMemoryPropertyFlags properties = this->settings.properties;
+    if ((properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) && !this->device->memory_allocator->supports(mem_requirements.memoryTypeBits, properties))
     {
-        std::cerr << "Failed to find suitable memory type!" << std::endl;
-        return -1;
+        properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     }
-    alloc_info.memoryTypeIndex = idx.value();
-
-    if (vkAllocateMemory(this->device->device, &alloc_info, nullptr, &memory) != VK_SUCCESS)
+    std::optional<memory_allocation_t> opt_allocation = this->device->memory_allocator->allocate(mem_requirements, properties);
+    if (!opt_allocation.has_value())
     {
         std::cerr << "Failed to allocate image memory!" << std::endl;
+        vkDestroyImage(this->device->device, image, this->allocator);
         return -1;
     }
+    allocation = opt_allocation.value();
+    this->memory = allocation.memory;
 
-    vkBindImageMemory(this->device->device, image, memory, 0);
+    vkBindImageMemory(this->device->device, image, allocation.memory, allocation.offset);
 
     return 0;
 }
@@ -112,9 +118,12 @@ std::int32_t image_t::create_image_sampler(const sampler_settings_t& settings)
     return 0;
 }
 
-std::int32_t image_t::transition_image_layout(VkImageLayout layout)
+std::int32_t image_t::transition_image_layout(VkImageLayout layout, VkCommandBuffer command_buffer)
 {
-    VkCommandBuffer command_buffer = begin_single_time_commands(this->device->device, *this->command_pool);
+    if (command_buffer == VK_NULL_HANDLE)
+    {
+        command_buffer = this->device->upload_context->get_command_buffer();
+    }
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -130,7 +139,7 @@ std::int32_t image_t::transition_image_layout(VkImageLayout layout)
 
     VkPipelineStageFlags src_stage, dst_stage;
 
-    if (layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+    if (layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL || has_depth_component(this->format))
     {
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
         if (has_stencil_component(this->format))
@@ -178,6 +187,13 @@ std::int32_t image_t::transition_image_layout(VkImageLayout layout)
         src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
         dst_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     }
+    else if (layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+    {
+        barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        src_stage = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
     else if (layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
     {
         barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -202,7 +218,41 @@ std::int32_t image_t::transition_image_layout(VkImageLayout layout)
 
     this->layout = layout;
 
-    end_single_time_commands(*this->command_pool, command_buffer, this->device->device, this->device->graphics_queue);
+    return 0;
+}
+
+std::int32_t image_t::read_back(std::vector<std::uint8_t>& pixels)
+{
+    if (this->device == nullptr)
+    {
+        std::cerr << "No image initialized!" << std::endl;
+        return -1;
+    }
+    if (this->format != VK_FORMAT_R8G8B8A8_SRGB && this->format != VK_FORMAT_R8G8B8A8_UNORM
+            && this->format != VK_FORMAT_B8G8R8A8_SRGB && this->format != VK_FORMAT_B8G8R8A8_UNORM)
+    {
+        std::cerr << "Unsupported read back format!" << std::endl;
+        return -1;
+    }
+    if (this->layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && this->layout != VK_IMAGE_LAYOUT_GENERAL)
+    {
+        std::cerr << "Image is not in a transfer source layout!" << std::endl;
+        return -1;
+    }
+
+    buffer_t readback_buffer(this->physical_device, this->command_pool);
+    buffer_settings_t buffer_settings;
+    buffer_settings.size = static_cast<VkDeviceSize>(this->width) * this->height * 4;
+    buffer_settings.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_settings.memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (readback_buffer.init(buffer_settings, this->device) != 0) return -1;
+
+    copy_image_to_buffer(readback_buffer.buffer);
+
+    readback_buffer.map_memory();
+    pixels.resize(buffer_settings.size);
+    std::memcpy(pixels.data(), readback_buffer.mapped_memory, pixels.size());
+
     return 0;
 }
 
@@ -235,8 +285,31 @@ std::optional<VkFormat> find_depth_format(const VkPhysicalDevice* physical_devic
             );
 }
 
-void image_t::copy_buffer_to_image(VkBuffer buffer)
+void image_t::copy_buffer_to_image(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset)
+{
+    VkBufferImageCopy region{};
+    region.bufferOffset = offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = {
+        this->width,
+        this->height,
+        1
+    };
+
+    vkCmdCopyBufferToImage(command_buffer, buffer, this->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+void image_t::copy_image_to_buffer(VkBuffer buffer)
 {
+    this->device->upload_context->flush();
     VkCommandBuffer command_buffer = begin_single_time_commands(this->device->device, *this->command_pool);
 
     VkBufferImageCopy region{};
@@ -256,14 +329,14 @@ void image_t::copy_buffer_to_image(VkBuffer buffer)
         1
     };
 
-    vkCmdCopyBufferToImage(command_buffer, buffer, this->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    vkCmdCopyImageToBuffer(command_buffer, this->image, this->layout, buffer, 1, &region);
 
     end_single_time_commands(*this->command_pool, command_buffer, this->device->device, this->device->graphics_queue);
 }
 
-std::int32_t image_t::generate_mipmaps()
+std::int32_t image_t::generate_mipmaps(VkCommandBuffer command_buffer)
 {
-    
+
     VkFormatProperties format_properties;
     vkGetPhysicalDeviceFormatProperties(*this->physical_device, this->format, &format_properties);
 
@@ -273,8 +346,6 @@ std::int32_t image_t::generate_mipmaps()
         return -1;
     }
 
-    VkCommandBuffer command_buffer = begin_single_time_commands(this->device->device, *this->command_pool);
-
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.image = this->image;
@@ -350,36 +421,75 @@ std::int32_t image_t::generate_mipmaps()
 
     this->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    end_single_time_commands(*this->command_pool, command_buffer, this->device->device, this->device->graphics_queue);
-
     return 0;
 }
 
-std::int32_t image_t::init_texture(const std::string& path, const image_settings_t& settings, const logical_device_t* device, bool flip)
+std::optional<decoded_image_t> decode_image(const std::string& path, bool flip)
 {
-    std::int32_t width, height, channels;
-    stbi_set_flip_vertically_on_load(flip);
-    stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-    VkDeviceSize image_size = width * height * 4;
-    if (!pixels)
+    decoded_image_t decoded;
+    decoded.path = path;
+    std::int32_t channels;
+    // the stb flip flag is global, flip rows here so decoding is safe on worker threads
+    decoded.pixels = stbi_load(path.c_str(), &decoded.width, &decoded.height, &channels, STBI_rgb_alpha);
+    if (!decoded.pixels)
     {
         std::cerr << "Failed to load image: " << path << "!" << std::endl;
+        return std::nullopt;
+    }
+
+    if (flip)
+    {
+        std::size_t row_size = static_cast<std::size_t>(decoded.width) * 4;
+        std::vector<stbi_uc> row(row_size);
+        for (std::int32_t y = 0; y < decoded.height / 2; ++y)
+        {
+            stbi_uc* top = decoded.pixels + y * row_size;
+            stbi_uc* bottom = decoded.pixels + (decoded.height - 1 - y) * row_size;
+            std::memcpy(row.data(), top, row_size);
+            std::memcpy(top, bottom, row_size);
+            std::memcpy(bottom, row.data(), row_size);
+        }
+    }
+
+    return decoded;
+}
+
+void free_decoded_image(decoded_image_t& decoded)
+{
+    stbi_image_free(decoded.pixels);
+    decoded.pixels = nullptr;
+}
+
+std::int32_t image_t::init_texture(const std::string& path, const image_settings_t& settings, const logical_device_t* device, bool flip)
+{
+    std::optional<decoded_image_t> decoded = decode_image(path, flip);
+    if (!decoded.has_value())
+    {
         return -1;
     }
 
+    std::int32_t res = init_texture(decoded.value(), settings, device);
+    free_decoded_image(decoded.value());
+    return res;
+}
+
+std::int32_t image_t::init_texture(const decoded_image_t& decoded, const image_settings_t& settings, const logical_device_t* device)
+{
+    std::int32_t width = decoded.width, height = decoded.height;
+    VkDeviceSize image_size = static_cast<VkDeviceSize>(width) * height * 4;
+
     this->settings = settings;
     this->settings.mip_levels = static_cast<std::uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
 
-    buffer_t staging_buffer(this->physical_device, this->command_pool);
-    buffer_settings_t buffer_settings;
-    buffer_settings.size = image_size;
-    buffer_settings.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    buffer_settings.memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    staging_buffer.init(buffer_settings, device);
-    staging_buffer.set_data(pixels);
-    
+    std::optional<std::pair<VkBuffer, VkDeviceSize>> staged = device->upload_context->stage(decoded.pixels, image_size);
+    if (!staged.has_value())
+    {
+        std::cerr << "Failed to stage image: " << decoded.path << "!" << std::endl;
+        return -1;
+    }
+
     this->device = device;
-    if (create_image(width, height, this->image, this->memory) != 0)
+    if (create_image(width, height, this->image, this->allocation) != 0)
     {
         this->device = nullptr;
         return -1;
@@ -390,9 +500,16 @@ std::int32_t image_t::init_texture(const std::string& path, const image_settings
     this->format = settings.format;
     this->layout = settings.layout;
 
-    transition_image_layout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copy_buffer_to_image(staging_buffer.buffer);
-    generate_mipmaps();
+    VkCommandBuffer transfer_command_buffer = device->upload_context->get_transfer_command_buffer();
+    transition_image_layout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, transfer_command_buffer);
+    copy_buffer_to_image(transfer_command_buffer, staged->first, staged->second);
+
+    VkImageSubresourceRange range{};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.levelCount = this->settings.mip_levels;
+    range.layerCount = this->settings.layer_count;
+    device->upload_context->transfer_ownership(this->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    generate_mipmaps(device->upload_context->get_command_buffer());
 
     image_view_settings_t image_view_settings = {
         .view = &this->view,
@@ -421,7 +538,7 @@ std::int32_t image_t::init_depth_buffer(image_settings_t settings, const VkExten
 
     this->settings = settings;
     this->device = device;
-    if (create_image(extent.width, extent.height, this->image, this->memory) != 0)
+    if (create_image(extent.width, extent.height, this->image, this->allocation) != 0)
     {
         this->device = nullptr;
         return -1;
@@ -435,10 +552,12 @@ std::int32_t image_t::init_depth_buffer(image_settings_t settings, const VkExten
 
     image_view_settings_t image_view_settings = {
         .view = &this->view,
+        .type = (settings.layer_count > 1) ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
         .image = this->image,
         .format = settings.format,
         .device = device->device,
-        .aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT
+        .aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .layer_count = settings.layer_count
     };
     create_image_view(image_view_settings);
     transition_image_layout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
@@ -450,7 +569,7 @@ std::int32_t image_t::init_color_buffer(image_settings_t settings, const VkExten
 {
     this->settings = settings;
     this->device = device;
-    if (create_image(extent.width, extent.height, this->image, this->memory) != 0)
+    if (create_image(extent.width, extent.height, this->image, this->allocation) != 0)
     {
         this->device = nullptr;
         return -1;
@@ -518,6 +637,6 @@ image_t::~image_t()
     DEBUG_PRINT("Destroying secondary image view(s)!")
     vkDestroyImage(this->device->device, this->image, this->allocator);
     DEBUG_PRINT("Destroying Image!")
-    vkFreeMemory(this->device->device, this->memory, nullptr);
+    this->device->memory_allocator->free(this->allocation);
     DEBUG_PRINT("Freeing Image Memory!")
 }
@@ -57,6 +57,14 @@ struct sampler_settings_t
     } lod;
 };
 
+struct decoded_image_t
+{
+    std::string path;
+    std::int32_t width = 0;
+    std::int32_t height = 0;
+    stbi_uc* pixels = nullptr;
+};
+
 class image_t
 {
     private:
@@ -65,9 +73,10 @@ class image_t
         const logical_device_t* device = nullptr;
         const VkAllocationCallbacks* allocator = nullptr;
 
-        std::int32_t create_image(std::uint32_t width, std::uint32_t height, VkImage& image, VkDeviceMemory& memory);
-        void copy_buffer_to_image(VkBuffer buffer);
-        std::int32_t generate_mipmaps();
+        std::int32_t create_image(std::uint32_t width, std::uint32_t height, VkImage& image, memory_allocation_t& allocation);
+        void copy_buffer_to_image(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset);
+        void copy_image_to_buffer(VkBuffer buffer);
+        std::int32_t generate_mipmaps(VkCommandBuffer command_buffer);
 
     public:
         image_settings_t settings{};
@@ -78,14 +87,17 @@ class image_t
         std::vector<VkImageView> secondary_views;
         VkSampler sampler = VK_NULL_HANDLE;
         VkDeviceMemory memory;
+        memory_allocation_t allocation;
         VkImageLayout layout;
         VkFormat format;
 
         std::int32_t init_texture(const std::string& path, const image_settings_t& settings, const logical_device_t* device, bool flip = false);
+        std::int32_t init_texture(const decoded_image_t& decoded, const image_settings_t& settings, const logical_device_t* device);
         std::int32_t init_depth_buffer(image_settings_t settings, const VkExtent2D& extent, const logical_device_t* device);
         std::int32_t init_color_buffer(image_settings_t settings, const VkExtent2D& extent, const logical_device_t* device, std::optional<image_view_settings_t> view_settings = std::nullopt);
         std::int32_t create_image_sampler(const sampler_settings_t& settings);
-        std::int32_t transition_image_layout(VkImageLayout layout);
+        std::int32_t transition_image_layout(VkImageLayout layout, VkCommandBuffer command_buffer = VK_NULL_HANDLE);
+        std::int32_t read_back(std::vector<std::uint8_t>& pixels);
         image_t(const VkPhysicalDevice* physical_device, const VkCommandPool* command_pool);
         ~image_t();
 };
@@ -93,3 +105,5 @@ class image_t
 std::optional<VkFormat> find_supported_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags featrues, const VkPhysicalDevice* physical_device);
 std::optional<VkFormat> find_depth_format(const VkPhysicalDevice* physical_device);
 std::int32_t create_image_view(image_view_settings_t& settings);
+std::optional<decoded_image_t> decode_image(const std::string& path, bool flip = false);
+void free_decoded_image(decoded_image_t& decoded);
@@ -10,6 +10,8 @@ std::int32_t logical_device_t::init()
 {
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
     std::set<std::uint32_t> unique_queue_families = { indices.graphics_family.value(), indices.present_family.value() };
+    if (this->indices.transfer_family.has_value()) unique_queue_families.insert(this->indices.transfer_family.value());
+    if (this->indices.compute_family.has_value()) unique_queue_families.insert(this->indices.compute_family.value());
 
     float queue_priority = 1.0f;
     for (std::uint32_t queue_family : unique_queue_families)
@@ -26,14 +28,44 @@ std::int32_t logical_device_t::init()
     device_features.samplerAnisotropy = VK_TRUE;
     device_features.sampleRateShading = VK_TRUE;
 
+    // the vulkan 1.2 feature struct may only be chained on devices that implement 1.2
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(*(this->physical_device), &properties);
+    bool vulkan12 = properties.apiVersion >= VK_API_VERSION_1_2;
+
+    VkPhysicalDeviceVulkan12Features vulkan12_features{};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceMultiviewFeatures multiview_features{};
+    multiview_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+    multiview_features.pNext = vulkan12 ? &vulkan12_features : nullptr;
+    VkPhysicalDeviceFeatures2 supported_features{};
+    supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features.pNext = &multiview_features;
+    vkGetPhysicalDeviceFeatures2(*(this->physical_device), &supported_features);
+    this->multiview = multiview_features.multiview == VK_TRUE;
+    multiview_features.multiviewGeometryShader = VK_FALSE;
+    multiview_features.multiviewTessellationShader = VK_FALSE;
+
+    // gpu driven rendering needs the draw count from a buffer, more than one draw per indirect call and the instance offset of each draw
+    this->draw_indirect_count = vulkan12 && vulkan12_features.drawIndirectCount == VK_TRUE && supported_features.features.multiDrawIndirect == VK_TRUE &&
+            supported_features.features.drawIndirectFirstInstance == VK_TRUE;
+    VkBool32 draw_indirect_count = this->draw_indirect_count ? VK_TRUE : VK_FALSE;
+    vulkan12_features = {};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12_features.drawIndirectCount = draw_indirect_count;
+    device_features.multiDrawIndirect = draw_indirect_count;
+    device_features.drawIndirectFirstInstance = draw_indirect_count;
+
     VkDeviceCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    create_info.pNext = &multiview_features;
     create_info.pQueueCreateInfos = queue_create_infos.data();
     create_info.queueCreateInfoCount = static_cast<std::uint32_t>(queue_create_infos.size());
     create_info.pEnabledFeatures = &device_features;
 
-    create_info.enabledExtensionCount = static_cast<std::uint32_t>(device_extensions.size());
-    create_info.ppEnabledExtensionNames = device_extensions.data();
+    const std::vector<const char*>& extensions = (this->headless) ? headless_device_extensions : device_extensions;
+    create_info.enabledExtensionCount = static_cast<std::uint32_t>(extensions.size());
+    create_info.ppEnabledExtensionNames = extensions.data();
 
     if (ENABLE_VALIDATION_LAYERS)
     {
@@ -52,17 +84,46 @@ std::int32_t logical_device_t::init()
     
     vkGetDeviceQueue(this->device, this->indices.graphics_family.value(), 0, &(this->graphics_queue));
     vkGetDeviceQueue(this->device, this->indices.present_family.value(), 0, &(this->present_queue));
+    this->transfer_queue = this->graphics_queue;
+    if (has_dedicated_transfer())
+    {
+        vkGetDeviceQueue(this->device, this->indices.transfer_family.value(), 0, &(this->transfer_queue));
+    }
+    this->compute_queue = this->graphics_queue;
+    if (has_async_compute())
+    {
+        vkGetDeviceQueue(this->device, this->indices.compute_family.value(), 0, &(this->compute_queue));
+    }
+
+    this->memory_allocator = new memory_allocator_t();
+    if (this->memory_allocator->init(&this->device, *this->physical_device) != 0)
+    {
+        std::cerr << "Failed to create memory allocator!" << std::endl;
+        return -1;
+    }
 
     return 0;
 }
 
+bool logical_device_t::has_dedicated_transfer() const
+{
+    return this->indices.transfer_family.has_value() && this->indices.transfer_family != this->indices.graphics_family;
+}
+
+bool logical_device_t::has_async_compute() const
+{
+    return this->indices.compute_family.has_value() && this->indices.compute_family != this->indices.graphics_family;
+}
+
 logical_device_t::logical_device_t(VkPhysicalDevice* physical_device, VkSurfaceKHR& surface) : indices(*physical_device, surface)
 {
     this->physical_device = physical_device;
+    this->headless = (surface == VK_NULL_HANDLE);
 }
 
 logical_device_t::~logical_device_t()
 {
+    delete this->memory_allocator;
     vkDestroyDevice(this->device, this->allocator);
     DEBUG_PRINT("Destroying Logical Device!");
 }
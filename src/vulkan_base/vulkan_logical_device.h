@@ -1,21 +1,33 @@
 #pragma once
 
 #include "vulkan_queue_family_indices.h"
+#include "vulkan_memory_allocator.h"
 #include <cstdint>
 #include <vulkan/vulkan_core.h>
 
+class upload_context_t;
+
 class logical_device_t
 {
     private:
         const VkPhysicalDevice* physical_device;
         const VkAllocationCallbacks* allocator = nullptr;
+        bool headless = false;
     
     public:
         VkDevice device;
         VkQueue graphics_queue;
         VkQueue present_queue;
+        VkQueue transfer_queue = VK_NULL_HANDLE;
+        VkQueue compute_queue = VK_NULL_HANDLE;
         queue_family_indices_t indices;
+        memory_allocator_t* memory_allocator = nullptr;
+        upload_context_t* upload_context = nullptr;
+        bool multiview = false;
+        bool draw_indirect_count = false;
         
+        bool has_dedicated_transfer() const;
+        bool has_async_compute() const;
         std::int32_t init();
         logical_device_t(VkPhysicalDevice* physical_device, VkSurfaceKHR& surface);
         ~logical_device_t();
@@ -0,0 +1,259 @@
+#include "vulkan_memory_allocator.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+#include "debug_print.h"
+
+std::int32_t memory_allocator_t::init(const VkDevice* device, VkPhysicalDevice physical_device, VkDeviceSize block_size)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &this->memory_properties);
+
+    this->device = device;
+    this->block_size = block_size;
+    this->granularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    this->blocks.resize(this->memory_properties.memoryTypeCount);
+
+    return 0;
+}
+
+std::optional<std::uint32_t> memory_allocator_t::find_memory_type(std::uint32_t type_filter, VkMemoryPropertyFlags properties)
+{
+    for (std::uint32_t i = 0; i < this->memory_properties.memoryTypeCount; ++i)
+    {
+        if (type_filter & (1 << i) && (this->memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    return std::nullopt;
+}
+
+std::optional<VkDeviceMemory> memory_allocator_t::allocate_memory(std::uint32_t memory_type, VkDeviceSize size, void** mapped)
+{
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(*this->device, &alloc_info, this->allocator, &memory) != VK_SUCCESS)
+    {
+        std::cerr << "Failed to allocate device memory!" << std::endl;
+        return std::nullopt;
+    }
+
+    *mapped = nullptr;
+    if (this->memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        vkMapMemory(*this->device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+    }
+
+    return memory;
+}
+
+std::optional<VkDeviceSize> memory_allocator_t::allocate_from_block(memory_block_t* block, VkDeviceSize size, VkDeviceSize alignment)
+{
+    for (auto it = block->free_ranges.begin(); it != block->free_ranges.end(); ++it)
+    {
+        VkDeviceSize range_offset = it->first;
+        VkDeviceSize range_size = it->second;
+        VkDeviceSize offset = (range_offset + alignment - 1) / alignment * alignment;
+        if (offset + size > range_offset + range_size)
+        {
+            continue;
+        }
+
+        block->free_ranges.erase(it);
+        if (offset > range_offset)
+        {
+            block->free_ranges[range_offset] = offset - range_offset;
+        }
+        if (offset + size < range_offset + range_size)
+        {
+            block->free_ranges[offset + size] = range_offset + range_size - offset - size;
+        }
+        return offset;
+    }
+
+    return std::nullopt;
+}
+
+std::optional<memory_allocation_t> memory_allocator_t::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties)
+{
+    std::optional<std::uint32_t> memory_type = find_memory_type(requirements.memoryTypeBits, properties);
+    if (!memory_type.has_value())
+    {
+        std::cerr << "Failed to find suitable memory type!" << std::endl;
+        return std::nullopt;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    memory_allocation_t allocation;
+    allocation.memory_type = memory_type.value();
+    allocation.size = requirements.size;
+
+    // lazily allocated memory is committed per allocation, a shared block would back every transient attachment with real memory
+    bool lazy = this->memory_properties.memoryTypes[allocation.memory_type].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    if (requirements.size > this->block_size / 2 || lazy)
+    {
+        std::optional<VkDeviceMemory> memory = allocate_memory(allocation.memory_type, requirements.size, &allocation.mapped);
+        if (!memory.has_value())
+        {
+            return std::nullopt;
+        }
+        allocation.memory = memory.value();
+        allocation.dedicated = true;
+        ++this->statistics.dedicated_count;
+        ++this->statistics.allocation_count;
+        this->statistics.bytes_reserved += requirements.size;
+        this->statistics.bytes_used += requirements.size;
+        return allocation;
+    }
+
+    // linear and optimal resources may share a block, so keep them bufferImageGranularity apart
+    VkDeviceSize alignment = std::max(requirements.alignment, this->granularity);
+    VkDeviceSize size = (requirements.size + this->granularity - 1) / this->granularity * this->granularity;
+
+    std::vector<memory_block_t*>& type_blocks = this->blocks[allocation.memory_type];
+    for (memory_block_t* block : type_blocks)
+    {
+        std::optional<VkDeviceSize> offset = allocate_from_block(block, size, alignment);
+        if (offset.has_value())
+        {
+            allocation.memory = block->memory;
+            allocation.offset = offset.value();
+            allocation.size = size;
+            allocation.mapped = (block->mapped != nullptr) ? static_cast<std::uint8_t*>(block->mapped) + offset.value() : nullptr;
+            ++block->allocation_count;
+            ++this->statistics.allocation_count;
+            this->statistics.bytes_used += size;
+            return allocation;
+        }
+    }
+
+    memory_block_t* block = new memory_block_t();
+    std::optional<VkDeviceMemory> memory = allocate_memory(allocation.memory_type, this->block_size, &block->mapped);
+    if (!memory.has_value())
+    {
+        delete block;
+        return std::nullopt;
+    }
+    block->memory = memory.value();
+    block->size = this->block_size;
+    block->free_ranges[0] = this->block_size;
+    type_blocks.push_back(block);
+    ++this->statistics.block_count;
+    this->statistics.bytes_reserved += this->block_size;
+
+    std::optional<VkDeviceSize> offset = allocate_from_block(block, size, alignment);
+    allocation.memory = block->memory;
+    allocation.offset = offset.value();
+    allocation.size = size;
+    allocation.mapped = (block->mapped != nullptr) ? static_cast<std::uint8_t*>(block->mapped) + offset.value() : nullptr;
+    ++block->allocation_count;
+    ++this->statistics.allocation_count;
+    this->statistics.bytes_used += size;
+
+    return allocation;
+}
+
+bool memory_allocator_t::supports(std::uint32_t type_filter, VkMemoryPropertyFlags properties)
+{
+    return find_memory_type(type_filter, properties).has_value();
+}
+
+void memory_allocator_t::free(const memory_allocation_t& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    --this->statistics.allocation_count;
+    this->statistics.bytes_used -= allocation.size;
+
+    if (allocation.dedicated)
+    {
+        vkFreeMemory(*this->device, allocation.memory, this->allocator);
+        --this->statistics.dedicated_count;
+        this->statistics.bytes_reserved -= allocation.size;
+        return;
+    }
+
+    std::vector<memory_block_t*>& type_blocks = this->blocks[allocation.memory_type];
+    for (auto it = type_blocks.begin(); it != type_blocks.end(); ++it)
+    {
+        memory_block_t* block = *it;
+        if (block->memory != allocation.memory)
+        {
+            continue;
+        }
+
+        VkDeviceSize offset = allocation.offset;
+        VkDeviceSize size = allocation.size;
+        auto next = block->free_ranges.lower_bound(offset);
+        if (next != block->free_ranges.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = block->free_ranges.erase(next);
+        }
+        if (next != block->free_ranges.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset)
+            {
+                offset = prev->first;
+                size += prev->second;
+                block->free_ranges.erase(prev);
+            }
+        }
+        block->free_ranges[offset] = size;
+        --block->allocation_count;
+
+        // one empty block per type is kept around for the next allocation, any further one goes back to the driver
+        bool spare = block->allocation_count == 0 && std::any_of(type_blocks.begin(), type_blocks.end(),
+                [&](const memory_block_t* other) { return other != block && other->allocation_count == 0; });
+        if (spare)
+        {
+            vkFreeMemory(*this->device, block->memory, this->allocator);
+            --this->statistics.block_count;
+            this->statistics.bytes_reserved -= block->size;
+            type_blocks.erase(it);
+            delete block;
+        }
+        return;
+    }
+}
+
+memory_statistics_t memory_allocator_t::get_statistics()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->statistics;
+}
+
+memory_allocator_t::memory_allocator_t()
+{
+}
+
+memory_allocator_t::~memory_allocator_t()
+{
+    if (this->device == nullptr) return;
+    DEBUG_PRINT("Memory Allocator: " << this->statistics.block_count << " block(s), " << this->statistics.dedicated_count << " dedicated, "
+            << this->statistics.allocation_count << " live allocation(s)")
+    for (std::vector<memory_block_t*>& type_blocks : this->blocks)
+    {
+        for (memory_block_t* block : type_blocks)
+        {
+            vkFreeMemory(*this->device, block->memory, this->allocator);
+            delete block;
+        }
+    }
+    DEBUG_PRINT("Freeing Memory Blocks!")
+}
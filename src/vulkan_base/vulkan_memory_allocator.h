@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+struct memory_allocation_t
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    std::uint32_t memory_type = 0;
+    bool dedicated = false;
+};
+
+struct memory_statistics_t
+{
+    std::uint32_t block_count = 0;
+    std::uint32_t dedicated_count = 0;
+    std::uint32_t allocation_count = 0;
+    VkDeviceSize bytes_reserved = 0;
+    VkDeviceSize bytes_used = 0;
+};
+
+class memory_allocator_t
+{
+    private:
+        struct memory_block_t
+        {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+            void* mapped = nullptr;
+            std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+            std::uint32_t allocation_count = 0;
+        };
+
+        const VkDevice* device = nullptr;
+        const VkAllocationCallbacks* allocator = nullptr;
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        VkDeviceSize block_size = 0;
+        VkDeviceSize granularity = 1;
+        std::vector<std::vector<memory_block_t*>> blocks;
+        memory_statistics_t statistics;
+        std::mutex mutex;
+
+        std::optional<std::uint32_t> find_memory_type(std::uint32_t type_filter, VkMemoryPropertyFlags properties);
+        std::optional<VkDeviceMemory> allocate_memory(std::uint32_t memory_type, VkDeviceSize size, void** mapped);
+        std::optional<VkDeviceSize> allocate_from_block(memory_block_t* block, VkDeviceSize size, VkDeviceSize alignment);
+
+    public:
+        std::int32_t init(const VkDevice* device, VkPhysicalDevice physical_device, VkDeviceSize block_size = 64 * 1024 * 1024);
+        std::optional<memory_allocation_t> allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties);
+        bool supports(std::uint32_t type_filter, VkMemoryPropertyFlags properties);
+        void free(const memory_allocation_t& allocation);
+        memory_statistics_t get_statistics();
+        memory_allocator_t();
+        ~memory_allocator_t();
+};
@@ -0,0 +1,179 @@
+#include "vulkan_profiler.h"
+#include <iostream>
+
+#include "debug_print.h"
+
+std::int32_t gpu_profiler_t::init(const logical_device_t* logical_device, VkPhysicalDevice physical_device, std::uint32_t frames_in_flight, std::uint32_t max_scopes)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    std::uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+
+    std::uint32_t valid_bits = queue_families[logical_device->indices.graphics_family.value()].timestampValidBits;
+    if (valid_bits == 0 || properties.limits.timestampPeriod == 0.0f)
+    {
+        std::cerr << "Timestamp queries are not supported on the graphics queue!" << std::endl;
+        this->enabled = false;
+        return -1;
+    }
+    this->timestamp_mask = (valid_bits >= 64) ? ~0ull : ((1ull << valid_bits) - 1);
+    this->timestamp_period = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    create_info.queryCount = frames_in_flight * max_scopes * 2;
+
+    if (vkCreateQueryPool(logical_device->device, &create_info, this->allocator, &this->query_pool) != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create timestamp query pool!" << std::endl;
+        this->enabled = false;
+        return -1;
+    }
+
+    this->device = &(logical_device->device);
+    this->frames_in_flight = frames_in_flight;
+    this->max_scopes = max_scopes;
+    this->scope_names.resize(frames_in_flight);
+    this->slot_tags.resize(frames_in_flight, 0);
+
+    return 0;
+}
+
+std::int32_t gpu_profiler_t::resolve(std::uint32_t frame)
+{
+    const std::vector<std::string>& names = this->scope_names[frame];
+    if (names.empty())
+    {
+        return -1;
+    }
+
+    std::vector<std::uint64_t> timestamps(names.size() * 2);
+    VkResult result = vkGetQueryPoolResults(*this->device, this->query_pool, frame * this->max_scopes * 2, static_cast<std::uint32_t>(timestamps.size()),
+            timestamps.size() * sizeof(std::uint64_t), timestamps.data(), sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+    {
+        return -1;
+    }
+
+    this->results.clear();
+    this->results_tag = this->slot_tags[frame];
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        std::uint64_t begin = timestamps[2 * i] & this->timestamp_mask;
+        std::uint64_t end = timestamps[2 * i + 1] & this->timestamp_mask;
+        double ms = (end >= begin) ? static_cast<double>(end - begin) * this->timestamp_period * 1e-6 : 0.0;
+        this->results.emplace_back(names[i], ms);
+    }
+    return 0;
+}
+
+void gpu_profiler_t::begin_frame(VkCommandBuffer command_buffer, std::uint32_t frame)
+{
+    if (!this->enabled || this->device == nullptr)
+    {
+        return;
+    }
+
+    // the fence of this frame slot has been waited on, so its queries are available without stalling
+    resolve(frame);
+
+    this->current_frame = frame;
+    this->scope_names[frame].clear();
+    this->slot_tags[frame] = this->frame_tag;
+    vkCmdResetQueryPool(command_buffer, this->query_pool, frame * this->max_scopes * 2, this->max_scopes * 2);
+}
+
+// scopes are reserved up front so command buffers recorded on other threads can write their timestamps in a fixed order
+std::uint32_t gpu_profiler_t::add_scope(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->enabled || this->device == nullptr || this->scope_names[this->current_frame].size() >= this->max_scopes)
+    {
+        return INVALID_SCOPE;
+    }
+
+    this->scope_names[this->current_frame].push_back(name);
+    return static_cast<std::uint32_t>(this->scope_names[this->current_frame].size()) - 1;
+}
+
+void gpu_profiler_t::begin_scope(VkCommandBuffer command_buffer, std::uint32_t scope)
+{
+    if (scope == INVALID_SCOPE)
+    {
+        return;
+    }
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->query_pool, (this->current_frame * this->max_scopes + scope) * 2);
+}
+
+void gpu_profiler_t::end_scope(VkCommandBuffer command_buffer, std::uint32_t scope)
+{
+    if (scope == INVALID_SCOPE)
+    {
+        return;
+    }
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->query_pool, (this->current_frame * this->max_scopes + scope) * 2 + 1);
+}
+
+void gpu_profiler_t::begin_scope(VkCommandBuffer command_buffer, const std::string& name)
+{
+    begin_scope(command_buffer, add_scope(name));
+}
+
+void gpu_profiler_t::end_scope(VkCommandBuffer command_buffer)
+{
+    if (!this->enabled || this->device == nullptr || this->scope_names[this->current_frame].empty())
+    {
+        return;
+    }
+
+    end_scope(command_buffer, static_cast<std::uint32_t>(this->scope_names[this->current_frame].size()) - 1);
+}
+
+const std::vector<std::pair<std::string, double>>& gpu_profiler_t::get_results() const
+{
+    return this->results;
+}
+
+std::optional<std::uint32_t> gpu_profiler_t::get_results_tag() const
+{
+    return this->results_tag;
+}
+
+std::vector<std::pair<std::uint32_t, std::vector<std::pair<std::string, double>>>> gpu_profiler_t::drain()
+{
+    std::vector<std::pair<std::uint32_t, std::vector<std::pair<std::string, double>>>> drained;
+    if (!this->enabled || this->device == nullptr)
+    {
+        return drained;
+    }
+
+    // the slot after the current one was recorded first
+    for (std::uint32_t i = 1; i <= this->frames_in_flight; ++i)
+    {
+        std::uint32_t frame = (this->current_frame + i) % this->frames_in_flight;
+        if (resolve(frame) == 0)
+        {
+            drained.emplace_back(this->results_tag.value(), this->results);
+        }
+        this->scope_names[frame].clear();
+    }
+    return drained;
+}
+
+gpu_profiler_t::gpu_profiler_t()
+{
+}
+
+gpu_profiler_t::~gpu_profiler_t()
+{
+    if (this->device == nullptr) return;
+    vkDestroyQueryPool(*this->device, this->query_pool, this->allocator);
+    DEBUG_PRINT("Destroying Query Pool!");
+}
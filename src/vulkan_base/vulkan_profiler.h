@@ -0,0 +1,53 @@
+#pragma once
+
+#include "vulkan_logical_device.h"
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#define INVALID_SCOPE std::numeric_limits<std::uint32_t>::max()
+
+class gpu_profiler_t
+{
+    private:
+        const VkDevice* device = nullptr;
+        const VkAllocationCallbacks* allocator = nullptr;
+        VkQueryPool query_pool = VK_NULL_HANDLE;
+        std::uint32_t frames_in_flight = 0;
+        std::uint32_t max_scopes = 0;
+        std::uint32_t current_frame = 0;
+        std::uint64_t timestamp_mask = ~0ull;
+        float timestamp_period = 1.0f;
+        std::vector<std::vector<std::string>> scope_names;
+        std::vector<std::uint32_t> slot_tags;
+        std::vector<std::pair<std::string, double>> results;
+        std::optional<std::uint32_t> results_tag;
+        std::mutex mutex;
+
+        std::int32_t resolve(std::uint32_t frame);
+
+    public:
+        bool enabled = true;
+        /// Caller defined number of the frame being recorded, results carry it since they are resolved frames_in_flight frames later.
+        std::uint32_t frame_tag = 0;
+
+        std::int32_t init(const logical_device_t* logical_device, VkPhysicalDevice physical_device, std::uint32_t frames_in_flight, std::uint32_t max_scopes = 32);
+        void begin_frame(VkCommandBuffer command_buffer, std::uint32_t frame);
+        std::uint32_t add_scope(const std::string& name);
+        void begin_scope(VkCommandBuffer command_buffer, std::uint32_t scope);
+        void end_scope(VkCommandBuffer command_buffer, std::uint32_t scope);
+        void begin_scope(VkCommandBuffer command_buffer, const std::string& name);
+        void end_scope(VkCommandBuffer command_buffer);
+        const std::vector<std::pair<std::string, double>>& get_results() const;
+        /// The frame_tag of the frame the current results were recorded in, empty until the first frame is resolved.
+        std::optional<std::uint32_t> get_results_tag() const;
+        /// Resolves the frame slots that were never reused, the device has to be idle. Returns the results with their frame_tag in recording order.
+        std::vector<std::pair<std::uint32_t, std::vector<std::pair<std::string, double>>>> drain();
+        gpu_profiler_t();
+        ~gpu_profiler_t();
+};
@@ -1,5 +1,6 @@
 #include "vulkan_queue_family_indices.h"
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "debug_print.h"
@@ -21,9 +22,36 @@ queue_family_indices_t::queue_family_indices_t(VkPhysicalDevice physical_device,
     std::uint32_t i = 0;
     for (const VkQueueFamilyProperties& queue_family : queue_families)
     {
-        if (this->is_complete()) break;
+        if (!(queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            // prefer a transfer only family (dma engine) over a compute family for streaming
+            if ((queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT))
+            {
+                this->transfer_family = i;
+            }
+            else if ((queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !this->transfer_family.has_value())
+            {
+                this->transfer_family = i;
+            }
+            if ((queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT) && !this->compute_family.has_value())
+            {
+                this->compute_family = i;
+            }
+        }
+        if (this->is_complete())
+        {
+            ++i;
+            continue;
+        }
         VkBool32 present_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support);
+        if (surface == VK_NULL_HANDLE)
+        {
+            present_support = (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }
+        else
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support);
+        }
         if (present_support)
         {
             this->present_family = i;
@@ -34,4 +62,17 @@ queue_family_indices_t::queue_family_indices_t(VkPhysicalDevice physical_device,
         }
         ++i;
     }
+    if (this->transfer_family.has_value() && this->transfer_family == this->compute_family)
+    {
+        for (std::uint32_t j = 0; j < queue_family_count; ++j)
+        {
+            if (j != this->transfer_family.value() && (queue_families[j].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queue_families[j].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                this->compute_family = j;
+                break;
+            }
+        }
+    }
+    DEBUG_PRINT("\t\tTransfer Family: " << (this->transfer_family.has_value() ? std::to_string(this->transfer_family.value()) : "none")
+            << ", Compute Family: " << (this->compute_family.has_value() ? std::to_string(this->compute_family.value()) : "none"));
 }
@@ -9,6 +9,8 @@ class queue_family_indices_t
     public:
         std::optional<std::uint32_t> graphics_family;
         std::optional<std::uint32_t> present_family;
+        std::optional<std::uint32_t> transfer_family;
+        std::optional<std::uint32_t> compute_family;
         bool is_complete();
         queue_family_indices_t(VkPhysicalDevice physical_device, VkSurfaceKHR& surface);
 };
@@ -0,0 +1,727 @@
+#include "vulkan_render_graph.h"
+#include "vulkan_base.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+#include "debug_print.h"
+
+static bool reads_contents(render_graph_access_t access)
+{
+    return access != RENDER_GRAPH_WRITE_COLOR;
+}
+
+static bool writes_contents(render_graph_access_t access)
+{
+    return access == RENDER_GRAPH_WRITE_COLOR || access == RENDER_GRAPH_BLEND_COLOR || access == RENDER_GRAPH_WRITE_DEPTH;
+}
+
+static VkPipelineStageFlags access_stage(render_graph_access_t access)
+{
+    switch (access)
+    {
+        case RENDER_GRAPH_WRITE_COLOR:
+        case RENDER_GRAPH_BLEND_COLOR:
+            return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        case RENDER_GRAPH_WRITE_DEPTH:
+        case RENDER_GRAPH_TEST_DEPTH:
+            return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        default:
+            return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
+}
+
+static VkAccessFlags access_mask(render_graph_access_t access)
+{
+    switch (access)
+    {
+        case RENDER_GRAPH_WRITE_COLOR:
+            return VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        case RENDER_GRAPH_BLEND_COLOR:
+            return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        case RENDER_GRAPH_WRITE_DEPTH:
+            return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        case RENDER_GRAPH_TEST_DEPTH:
+            return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        case RENDER_GRAPH_READ_INPUT:
+            return VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        default:
+            return VK_ACCESS_SHADER_READ_BIT;
+    }
+}
+
+static VkImageLayout access_layout(render_graph_access_t access, render_graph_resource_type_t type)
+{
+    switch (access)
+    {
+        case RENDER_GRAPH_WRITE_COLOR:
+        case RENDER_GRAPH_BLEND_COLOR:
+            return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        case RENDER_GRAPH_WRITE_DEPTH:
+            return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        case RENDER_GRAPH_TEST_DEPTH:
+            return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        default:
+            // depth read in a shader keeps the read only depth layout, so a later subpass can test against it without a transition
+            return (type == RENDER_GRAPH_DEPTH) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+}
+
+render_graph_pass_t& render_graph_pass_t::write_color(const std::string& resource)
+{
+    this->accesses.emplace_back(resource, RENDER_GRAPH_WRITE_COLOR);
+    return *this;
+}
+
+render_graph_pass_t& render_graph_pass_t::blend_color(const std::string& resource)
+{
+    this->accesses.emplace_back(resource, RENDER_GRAPH_BLEND_COLOR);
+    return *this;
+}
+
+render_graph_pass_t& render_graph_pass_t::write_depth(const std::string& resource)
+{
+    this->accesses.emplace_back(resource, RENDER_GRAPH_WRITE_DEPTH);
+    return *this;
+}
+
+render_graph_pass_t& render_graph_pass_t::test_depth(const std::string& resource)
+{
+    this->accesses.emplace_back(resource, RENDER_GRAPH_TEST_DEPTH);
+    return *this;
+}
+
+render_graph_pass_t& render_graph_pass_t::read_input(const std::string& resource)
+{
+    this->accesses.emplace_back(resource, RENDER_GRAPH_READ_INPUT);
+    return *this;
+}
+
+render_graph_pass_t& render_graph_pass_t::read_texture(const std::string& resource)
+{
+    this->accesses.emplace_back(resource, RENDER_GRAPH_READ_TEXTURE);
+    return *this;
+}
+
+render_graph_pass_t& render_graph_pass_t::keep()
+{
+    this->side_effect = true;
+    return *this;
+}
+
+void render_graph_t::add_color_resource(const std::string& name, VkFormat format, VkSampleCountFlagBits sample_count)
+{
+    render_graph_resource_t resource;
+    resource.name = name;
+    resource.type = RENDER_GRAPH_COLOR;
+    resource.format = format;
+    resource.sample_count = sample_count;
+    resource.clear_value.color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
+    this->resources.push_back(resource);
+}
+
+void render_graph_t::add_depth_resource(const std::string& name, VkSampleCountFlagBits sample_count)
+{
+    render_graph_resource_t resource;
+    resource.name = name;
+    resource.type = RENDER_GRAPH_DEPTH;
+    resource.sample_count = sample_count;
+    resource.clear_value.depthStencil = { 1.0f, 0 };
+    this->resources.push_back(resource);
+}
+
+void render_graph_t::add_swap_chain_resource(const std::string& name)
+{
+    render_graph_resource_t resource;
+    resource.name = name;
+    resource.type = RENDER_GRAPH_SWAP_CHAIN;
+    resource.clear_value.color = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
+    resource.output = true;
+    this->resources.push_back(resource);
+}
+
+void render_graph_t::set_output(const std::string& name)
+{
+    std::optional<std::uint32_t> resource = find_resource(name);
+    if (resource.has_value())
+    {
+        this->resources[resource.value()].output = true;
+    }
+}
+
+render_graph_pass_t& render_graph_t::add_pass(const std::string& name)
+{
+    this->passes.push_back(render_graph_pass_t());
+    this->passes.back().name = name;
+    return this->passes.back();
+}
+
+std::optional<std::uint32_t> render_graph_t::find_resource(const std::string& name) const
+{
+    for (std::uint32_t i = 0; i < this->resources.size(); ++i)
+    {
+        if (this->resources[i].name == name) return i;
+    }
+    return std::nullopt;
+}
+
+std::optional<std::uint32_t> render_graph_t::find_pass(const std::string& name) const
+{
+    for (std::uint32_t i = 0; i < this->passes.size(); ++i)
+    {
+        if (this->passes[i].name == name) return i;
+    }
+    return std::nullopt;
+}
+
+std::int32_t render_graph_t::resolve()
+{
+    this->pass_accesses.assign(this->passes.size(), {});
+    for (std::uint32_t p = 0; p < this->passes.size(); ++p)
+    {
+        for (const std::pair<std::string, render_graph_access_t>& access : this->passes[p].accesses)
+        {
+            std::optional<std::uint32_t> resource = find_resource(access.first);
+            if (!resource.has_value())
+            {
+                std::cerr << "Failed to find render graph resource: " << access.first << "!" << std::endl;
+                return -1;
+            }
+            this->pass_accesses[p].emplace_back(resource.value(), access.second);
+        }
+    }
+
+    return 0;
+}
+
+std::vector<bool> render_graph_t::cull() const
+{
+    std::vector<bool> needed(this->resources.size());
+    for (std::uint32_t r = 0; r < this->resources.size(); ++r)
+    {
+        needed[r] = this->resources[r].output;
+    }
+
+    // walk backwards from the outputs, a pass survives if something later consumes one of its writes
+    std::vector<bool> alive(this->passes.size(), false);
+    for (std::uint32_t p = static_cast<std::uint32_t>(this->passes.size()); p-- > 0;)
+    {
+        alive[p] = this->passes[p].side_effect;
+        for (const std::pair<std::uint32_t, render_graph_access_t>& access : this->pass_accesses[p])
+        {
+            if (writes_contents(access.second) && needed[access.first]) alive[p] = true;
+        }
+        if (!alive[p])
+        {
+            DEBUG_PRINT("Culling render graph pass: " << this->passes[p].name)
+            continue;
+        }
+        for (const std::pair<std::uint32_t, render_graph_access_t>& access : this->pass_accesses[p])
+        {
+            if (reads_contents(access.second)) needed[access.first] = true;
+        }
+    }
+
+    return alive;
+}
+
+void render_graph_t::build_groups(const std::vector<bool>& alive)
+{
+    this->groups.clear();
+    this->pass_groups.assign(this->passes.size(), std::nullopt);
+    this->pass_subpasses.assign(this->passes.size(), 0);
+
+    // passes become subpasses of one render pass until one of them samples an attachment of that render pass
+    std::vector<std::optional<std::uint32_t>> attachment_groups(this->resources.size());
+    for (std::uint32_t p = 0; p < this->passes.size(); ++p)
+    {
+        if (!alive[p]) continue;
+
+        bool split = this->groups.empty();
+        for (const std::pair<std::uint32_t, render_graph_access_t>& access : this->pass_accesses[p])
+        {
+            if (access.second == RENDER_GRAPH_READ_TEXTURE && attachment_groups[access.first] == this->groups.size() - 1) split = true;
+        }
+        if (split)
+        {
+            this->groups.push_back(group_t());
+        }
+
+        std::uint32_t group_index = static_cast<std::uint32_t>(this->groups.size()) - 1;
+        group_t& group = this->groups.back();
+        this->pass_groups[p] = group_index;
+        this->pass_subpasses[p] = static_cast<std::uint32_t>(group.passes.size());
+        group.passes.push_back(p);
+        for (const std::pair<std::uint32_t, render_graph_access_t>& access : this->pass_accesses[p])
+        {
+            if (access.second == RENDER_GRAPH_READ_TEXTURE) continue;
+            attachment_groups[access.first] = group_index;
+            if (std::find(group.attachments.begin(), group.attachments.end(), access.first) == group.attachments.end())
+            {
+                group.attachments.push_back(access.first);
+            }
+        }
+    }
+}
+
+std::int32_t render_graph_t::allocate_images()
+{
+    this->lifetimes.assign(this->resources.size(), std::nullopt);
+    std::vector<VkImageUsageFlags> usages(this->resources.size(), 0);
+    std::vector<std::uint32_t> order;
+    for (std::uint32_t p = 0; p < this->passes.size(); ++p)
+    {
+        if (!this->pass_groups[p].has_value()) continue;
+        std::uint32_t group = this->pass_groups[p].value();
+        for (const std::pair<std::uint32_t, render_graph_access_t>& access : this->pass_accesses[p])
+        {
+            std::optional<std::pair<std::uint32_t, std::uint32_t>>& lifetime = this->lifetimes[access.first];
+            if (!lifetime.has_value())
+            {
+                lifetime = std::make_pair(group, group);
+                order.push_back(access.first);
+            }
+            lifetime->second = group;
+
+            switch (access.second)
+            {
+                case RENDER_GRAPH_WRITE_COLOR:
+                case RENDER_GRAPH_BLEND_COLOR:
+                    usages[access.first] |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                    break;
+                case RENDER_GRAPH_WRITE_DEPTH:
+                case RENDER_GRAPH_TEST_DEPTH:
+                    usages[access.first] |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                    break;
+                case RENDER_GRAPH_READ_INPUT:
+                    usages[access.first] |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+                    break;
+                case RENDER_GRAPH_READ_TEXTURE:
+                    usages[access.first] |= VK_IMAGE_USAGE_SAMPLED_BIT;
+                    break;
+            }
+        }
+    }
+
+    // resources whose lifetimes do not overlap share one image, outputs keep their own since they outlive the graph
+    // lifetimes are tracked per render pass group, attachments of one group never alias since they share its framebuffer
+    this->resource_images.assign(this->resources.size(), std::nullopt);
+    this->images.clear();
+    for (std::uint32_t r : order)
+    {
+        const render_graph_resource_t& resource = this->resources[r];
+        if (resource.type == RENDER_GRAPH_SWAP_CHAIN) continue;
+
+        const std::pair<std::uint32_t, std::uint32_t>& lifetime = this->lifetimes[r].value();
+        // the store ops of a resource used by a single group are all DONT_CARE, sampled images are read outside of the render pass though
+        bool transient = !resource.output && lifetime.first == lifetime.second && !(usages[r] & VK_IMAGE_USAGE_SAMPLED_BIT);
+        for (std::uint32_t i = 0; i < this->images.size() && !resource.output; ++i)
+        {
+            physical_image_t& image = this->images[i];
+            const render_graph_resource_t& owner = this->resources[image.resource];
+            if (image.aliasable && image.last_group < lifetime.first && owner.type == resource.type && owner.format == resource.format &&
+                    owner.sample_count == resource.sample_count)
+            {
+                DEBUG_PRINT("Aliasing render graph resource " << resource.name << " with " << owner.name)
+                image.usage |= usages[r];
+                image.last_group = lifetime.second;
+                image.transient = image.transient && transient;
+                this->resource_images[r] = i;
+                break;
+            }
+        }
+        if (this->resource_images[r].has_value()) continue;
+
+        physical_image_t image;
+        image.resource = r;
+        image.usage = usages[r];
+        image.last_group = lifetime.second;
+        image.aliasable = !resource.output;
+        image.transient = transient;
+        this->resource_images[r] = static_cast<std::uint32_t>(this->images.size());
+        this->images.push_back(image);
+    }
+
+    for (physical_image_t& image : this->images)
+    {
+        const render_graph_resource_t& resource = this->resources[image.resource];
+        image_settings_t settings;
+        settings.format = resource.format;
+        settings.usage = image.usage;
+        settings.sample_count = resource.sample_count;
+        if (image.transient)
+        {
+            DEBUG_PRINT("Render graph resource " << resource.name << " is transient")
+            settings.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            settings.properties = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        }
+
+        image_t* img = new image_t(&this->context->physical_device, &this->context->command_pool);
+        if (resource.type == RENDER_GRAPH_DEPTH)
+        {
+            if (img->init_depth_buffer(settings, this->context->get_swap_chain_extent(), this->context->device) != 0)
+            {
+                delete img;
+                std::cerr << "Failed to create render graph depth buffer!" << std::endl;
+                return -1;
+            }
+            if (image.usage & (VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT))
+            {
+                img->transition_image_layout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+            }
+            image.slot = static_cast<std::uint32_t>(this->context->depth_buffers.size());
+            this->context->depth_buffers.push_back(img);
+        }
+        else
+        {
+            if (img->init_color_buffer(settings, this->context->get_swap_chain_extent(), this->context->device) != 0)
+            {
+                delete img;
+                std::cerr << "Failed to create render graph color buffer!" << std::endl;
+                return -1;
+            }
+            if (image.usage & (VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT))
+            {
+                img->transition_image_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            }
+            image.slot = static_cast<std::uint32_t>(this->context->color_buffers.size());
+            this->context->color_buffers.push_back(img);
+        }
+    }
+
+    return 0;
+}
+
+std::optional<render_graph_access_t> render_graph_t::next_access(std::uint32_t resource, std::uint32_t group_index) const
+{
+    for (std::uint32_t g = group_index + 1; g < this->groups.size(); ++g)
+    {
+        for (std::uint32_t p : this->groups[g].passes)
+        {
+            for (const std::pair<std::uint32_t, render_graph_access_t>& access : this->pass_accesses[p])
+            {
+                if (access.first == resource) return access.second;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+std::int32_t render_graph_t::build_render_pass(group_t& group, std::uint32_t group_index, std::vector<resource_state_t>& states)
+{
+    struct access_state_t
+    {
+        std::uint32_t subpass = 0;
+        VkPipelineStageFlags stage = 0;
+        VkAccessFlags access = 0;
+    };
+
+    std::uint32_t resource_count = static_cast<std::uint32_t>(this->resources.size());
+    std::vector<std::int32_t> attachment_indices(resource_count, -1);
+    std::vector<std::optional<render_graph_access_t>> first_accesses(resource_count);
+    std::vector<render_graph_access_t> last_accesses(resource_count);
+    std::vector<std::uint32_t> first_subpasses(resource_count, 0), last_subpasses(resource_count, 0);
+    for (std::uint32_t i = 0; i < group.attachments.size(); ++i)
+    {
+        attachment_indices[group.attachments[i]] = static_cast<std::int32_t>(i);
+    }
+    for (std::uint32_t s = 0; s < group.passes.size(); ++s)
+    {
+        for (const std::pair<std::uint32_t, render_graph_access_t>& access : this->pass_accesses[group.passes[s]])
+        {
+            if (access.second == RENDER_GRAPH_READ_TEXTURE) continue;
+            if (!first_accesses[access.first].has_value())
+            {
+                first_accesses[access.first] = access.second;
+                first_subpasses[access.first] = s;
+            }
+            last_accesses[access.first] = access.second;
+            last_subpasses[access.first] = s;
+        }
+    }
+
+    render_pass_settings_t settings;
+    std::vector<bool> needed_after(resource_count, false);
+    std::vector<bool> sampled_after(resource_count, false);
+    group.clear_values.clear();
+    for (std::uint32_t r : group.attachments)
+    {
+        const render_graph_resource_t& resource = this->resources[r];
+        std::optional<render_graph_access_t> next = next_access(r, group_index);
+        needed_after[r] = resource.output || (next.has_value() && reads_contents(next.value()));
+        sampled_after[r] = next.has_value() && next.value() == RENDER_GRAPH_READ_TEXTURE;
+
+        VkAttachmentDescription attachment{};
+        switch (resource.type)
+        {
+            case RENDER_GRAPH_SWAP_CHAIN:
+                attachment.format = this->context->swap_chain->format.format;
+                break;
+            case RENDER_GRAPH_DEPTH:
+                attachment.format = find_depth_format(&this->context->physical_device).value();
+                break;
+            default:
+                attachment.format = resource.format;
+                break;
+        }
+        attachment.samples = resource.sample_count;
+        bool clear = first_accesses[r].value() == RENDER_GRAPH_WRITE_COLOR || first_accesses[r].value() == RENDER_GRAPH_WRITE_DEPTH;
+        attachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachment.storeOp = needed_after[r] ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : states[r].layout;
+        if (resource.type == RENDER_GRAPH_SWAP_CHAIN)
+        {
+            attachment.finalLayout = this->context->swap_chain->final_layout;
+        }
+        else
+        {
+            attachment.finalLayout = sampled_after[r] ? access_layout(RENDER_GRAPH_READ_TEXTURE, resource.type) : access_layout(last_accesses[r], resource.type);
+        }
+        settings.attachments.push_back(attachment);
+        group.clear_values.push_back(resource.clear_value);
+    }
+
+    std::map<std::pair<std::uint32_t, std::uint32_t>, VkSubpassDependency> dependencies;
+    auto add_dependency = [&](std::uint32_t src, std::uint32_t dst, VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+            VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+    {
+        if (src == dst) return;
+        VkSubpassDependency& dependency = dependencies[std::make_pair(src, dst)];
+        dependency.srcSubpass = src;
+        dependency.dstSubpass = dst;
+        dependency.srcStageMask |= (src_stage != 0) ? src_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        dependency.dstStageMask |= dst_stage;
+        dependency.srcAccessMask |= src_access;
+        dependency.dstAccessMask |= dst_access;
+        if (src != VK_SUBPASS_EXTERNAL && dst != VK_SUBPASS_EXTERNAL)
+        {
+            dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        }
+    };
+
+    std::vector<std::optional<access_state_t>> last_writes(resource_count);
+    std::vector<std::vector<access_state_t>> readers(resource_count);
+    std::vector<access_state_t> last_uses(resource_count);
+    std::vector<bool> touched(resource_count, false);
+    for (std::uint32_t s = 0; s < group.passes.size(); ++s)
+    {
+        subpass_t subpass;
+        for (const std::pair<std::uint32_t, render_graph_access_t>& access : this->pass_accesses[group.passes[s]])
+        {
+            std::uint32_t r = access.first;
+            VkPipelineStageFlags stage = access_stage(access.second);
+            VkAccessFlags mask = access_mask(access.second);
+
+            if (access.second == RENDER_GRAPH_READ_TEXTURE)
+            {
+                add_dependency(VK_SUBPASS_EXTERNAL, s, states[r].stage, states[r].access, stage, mask);
+                continue;
+            }
+
+            VkAttachmentReference reference = { static_cast<std::uint32_t>(attachment_indices[r]), access_layout(access.second, this->resources[r].type) };
+            switch (access.second)
+            {
+                case RENDER_GRAPH_WRITE_COLOR:
+                case RENDER_GRAPH_BLEND_COLOR:
+                    subpass.color_attachment_references.push_back(reference);
+                    break;
+                case RENDER_GRAPH_WRITE_DEPTH:
+                case RENDER_GRAPH_TEST_DEPTH:
+                    subpass.depth_attachment_reference[0] = reference;
+                    subpass.description.pDepthStencilAttachment = subpass.depth_attachment_reference.data();
+                    break;
+                default:
+                    subpass.input_attachment_references.push_back(reference);
+                    break;
+            }
+
+            if (!touched[r])
+            {
+                // first use in this render pass, wait for an earlier render pass or for the previous frame using the attachment
+                touched[r] = true;
+                VkAccessFlags previous_writes = mask & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+                if (states[r].stage != 0)
+                {
+                    add_dependency(VK_SUBPASS_EXTERNAL, s, states[r].stage, states[r].access, stage, mask);
+                }
+                else
+                {
+                    add_dependency(VK_SUBPASS_EXTERNAL, s, stage, (this->resources[r].type == RENDER_GRAPH_SWAP_CHAIN) ? 0 : previous_writes, stage, mask);
+                }
+            }
+            else
+            {
+                if (reads_contents(access.second) && last_writes[r].has_value())
+                {
+                    add_dependency(last_writes[r]->subpass, s, last_writes[r]->stage, last_writes[r]->access, stage, mask);
+                }
+                if (writes_contents(access.second))
+                {
+                    if (last_writes[r].has_value())
+                    {
+                        add_dependency(last_writes[r]->subpass, s, last_writes[r]->stage, last_writes[r]->access, stage, mask);
+                    }
+                    for (const access_state_t& reader : readers[r])
+                    {
+                        add_dependency(reader.subpass, s, reader.stage, 0, stage, mask);
+                    }
+                }
+            }
+
+            access_state_t state = { s, stage, mask };
+            if (writes_contents(access.second))
+            {
+                last_writes[r] = state;
+                readers[r].clear();
+            }
+            else
+            {
+                readers[r].push_back(state);
+            }
+            last_uses[r] = state;
+        }
+
+        // attachments that are still needed must be preserved by subpasses that do not touch them
+        for (std::uint32_t r : group.attachments)
+        {
+            bool used = std::any_of(this->pass_accesses[group.passes[s]].begin(), this->pass_accesses[group.passes[s]].end(),
+                    [&](const std::pair<std::uint32_t, render_graph_access_t>& access) { return access.first == r && access.second != RENDER_GRAPH_READ_TEXTURE; });
+            if (!used && first_subpasses[r] < s && (last_subpasses[r] > s || needed_after[r]))
+            {
+                subpass.preserve_attachments.push_back(static_cast<std::uint32_t>(attachment_indices[r]));
+            }
+        }
+        settings.subpasses.push_back(subpass);
+    }
+
+    for (subpass_t& subpass : settings.subpasses)
+    {
+        subpass.description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.description.colorAttachmentCount = static_cast<std::uint32_t>(subpass.color_attachment_references.size());
+        subpass.description.pColorAttachments = subpass.color_attachment_references.data();
+        subpass.description.inputAttachmentCount = static_cast<std::uint32_t>(subpass.input_attachment_references.size());
+        subpass.description.pInputAttachments = subpass.input_attachment_references.data();
+        subpass.description.preserveAttachmentCount = static_cast<std::uint32_t>(subpass.preserve_attachments.size());
+        subpass.description.pPreserveAttachments = subpass.preserve_attachments.data();
+        if (subpass.description.pDepthStencilAttachment != nullptr)
+        {
+            subpass.description.pDepthStencilAttachment = subpass.depth_attachment_reference.data();
+        }
+    }
+
+    for (std::uint32_t r : group.attachments)
+    {
+        if (needed_after[r])
+        {
+            add_dependency(last_uses[r].subpass, VK_SUBPASS_EXTERNAL, last_uses[r].stage, last_uses[r].access,
+                    sampled_after[r] ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    sampled_after[r] ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_MEMORY_READ_BIT);
+        }
+        states[r] = { settings.attachments[attachment_indices[r]].finalLayout, last_uses[r].stage, last_uses[r].access };
+    }
+    for (const std::pair<const std::pair<std::uint32_t, std::uint32_t>, VkSubpassDependency>& dependency : dependencies)
+    {
+        settings.dependencies.push_back(dependency.second);
+    }
+
+    render_pass_t* render_pass = new render_pass_t();
+    if (render_pass->init(settings, this->context->device->device) != 0)
+    {
+        delete render_pass;
+        return -1;
+    }
+
+    bool uses_swap_chain = std::any_of(group.attachments.begin(), group.attachments.end(),
+            [&](std::uint32_t r) { return this->resources[r].type == RENDER_GRAPH_SWAP_CHAIN; });
+    std::uint32_t framebuffer_count = uses_swap_chain ? static_cast<std::uint32_t>(this->context->swap_chain->image_views.size()) : 1;
+    VkExtent2D extent = this->context->get_swap_chain_extent();
+    for (std::uint32_t i = 0; i < framebuffer_count; ++i)
+    {
+        std::vector<framebuffer_attachment_t> attachments;
+        for (std::uint32_t r : group.attachments)
+        {
+            switch (this->resources[r].type)
+            {
+                case RENDER_GRAPH_SWAP_CHAIN:
+                    attachments.push_back({ &this->context->swap_chain, SWAP_CHAIN, i });
+                    break;
+                case RENDER_GRAPH_DEPTH:
+                    attachments.push_back({ &this->context->depth_buffers[this->images[this->resource_images[r].value()].slot], IMAGE });
+                    break;
+                default:
+                    attachments.push_back({ &this->context->color_buffers[this->images[this->resource_images[r].value()].slot], IMAGE });
+                    break;
+            }
+        }
+        if (render_pass->add_framebuffer(extent.width, extent.height, attachments) != 0)
+        {
+            delete render_pass;
+            return -1;
+        }
+    }
+
+    group.render_pass = render_pass;
+    this->context->render_passes.push_back(render_pass);
+
+    return 0;
+}
+
+std::int32_t render_graph_t::compile(vulkan_context_t* context)
+{
+    this->context = context;
+    if (resolve() != 0) return -1;
+    build_groups(cull());
+    if (allocate_images() != 0) return -1;
+
+    std::vector<resource_state_t> states(this->resources.size());
+    for (std::uint32_t g = 0; g < this->groups.size(); ++g)
+    {
+        if (build_render_pass(this->groups[g], g, states) != 0)
+        {
+            std::cerr << "Failed to build render graph render pass!" << std::endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+render_pass_t* render_graph_t::get_render_pass(const std::string& pass) const
+{
+    std::optional<std::uint32_t> index = find_pass(pass);
+    if (!index.has_value() || !this->pass_groups[index.value()].has_value()) return nullptr;
+    return this->groups[this->pass_groups[index.value()].value()].render_pass;
+}
+
+std::optional<std::uint32_t> render_graph_t::get_subpass(const std::string& pass) const
+{
+    std::optional<std::uint32_t> index = find_pass(pass);
+    if (!index.has_value() || !this->pass_groups[index.value()].has_value())
+    {
+        std::cerr << "Failed to find render graph pass: " << pass << "!" << std::endl;
+        return std::nullopt;
+    }
+    return this->pass_subpasses[index.value()];
+}
+
+const std::vector<VkClearValue>& render_graph_t::get_clear_values(const std::string& pass) const
+{
+    static const std::vector<VkClearValue> empty;
+    std::optional<std::uint32_t> index = find_pass(pass);
+    if (!index.has_value() || !this->pass_groups[index.value()].has_value()) return empty;
+    return this->groups[this->pass_groups[index.value()].value()].clear_values;
+}
+
+image_t** render_graph_t::get_image(const std::string& resource) const
+{
+    std::optional<std::uint32_t> index = find_resource(resource);
+    if (!index.has_value() || !this->resource_images[index.value()].has_value()) return nullptr;
+    const physical_image_t& image = this->images[this->resource_images[index.value()].value()];
+    if (this->resources[index.value()].type == RENDER_GRAPH_DEPTH)
+    {
+        return &this->context->depth_buffers[image.slot];
+    }
+    return &this->context->color_buffers[image.slot];
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "vulkan_render_pass.h"
+#include "vulkan_image.h"
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+class vulkan_context_t;
+
+enum render_graph_resource_type_t
+{
+    RENDER_GRAPH_COLOR,
+    RENDER_GRAPH_DEPTH,
+    RENDER_GRAPH_SWAP_CHAIN
+};
+
+enum render_graph_access_t
+{
+    RENDER_GRAPH_WRITE_COLOR,
+    RENDER_GRAPH_BLEND_COLOR,
+    RENDER_GRAPH_WRITE_DEPTH,
+    RENDER_GRAPH_TEST_DEPTH,
+    RENDER_GRAPH_READ_INPUT,
+    RENDER_GRAPH_READ_TEXTURE
+};
+
+struct render_graph_resource_t
+{
+    std::string name;
+    render_graph_resource_type_t type = RENDER_GRAPH_COLOR;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_1_BIT;
+    VkClearValue clear_value{};
+    bool output = false;
+};
+
+/// Color attachments are bound in the order of the write_color/blend_color calls, input attachments in the order of the read_input calls.
+struct render_graph_pass_t
+{
+    std::string name;
+    std::vector<std::pair<std::string, render_graph_access_t>> accesses;
+    bool side_effect = false;
+
+    render_graph_pass_t& write_color(const std::string& resource);
+    render_graph_pass_t& blend_color(const std::string& resource);
+    render_graph_pass_t& write_depth(const std::string& resource);
+    render_graph_pass_t& test_depth(const std::string& resource);
+    render_graph_pass_t& read_input(const std::string& resource);
+    render_graph_pass_t& read_texture(const std::string& resource);
+    render_graph_pass_t& keep();
+};
+
+class render_graph_t
+{
+    private:
+        struct group_t
+        {
+            std::vector<std::uint32_t> passes;
+            std::vector<std::uint32_t> attachments;
+            std::vector<VkClearValue> clear_values;
+            render_pass_t* render_pass = nullptr;
+        };
+
+        struct physical_image_t
+        {
+            std::uint32_t resource = 0;
+            VkImageUsageFlags usage = 0;
+            std::uint32_t last_group = 0;
+            std::uint32_t slot = 0;
+            bool aliasable = true;
+            /// Every resource in the image lives and dies inside one render pass, so its contents never have to leave tile memory.
+            bool transient = true;
+        };
+
+        struct resource_state_t
+        {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags stage = 0;
+            VkAccessFlags access = 0;
+        };
+
+        std::vector<render_graph_resource_t> resources;
+        std::deque<render_graph_pass_t> passes;
+        std::vector<std::vector<std::pair<std::uint32_t, render_graph_access_t>>> pass_accesses;
+        std::vector<std::optional<std::uint32_t>> pass_groups;
+        std::vector<std::uint32_t> pass_subpasses;
+        std::vector<std::optional<std::pair<std::uint32_t, std::uint32_t>>> lifetimes;
+        std::vector<std::optional<std::uint32_t>> resource_images;
+        std::vector<physical_image_t> images;
+        std::vector<group_t> groups;
+        vulkan_context_t* context = nullptr;
+
+        std::optional<std::uint32_t> find_resource(const std::string& name) const;
+        std::optional<std::uint32_t> find_pass(const std::string& name) const;
+        std::int32_t resolve();
+        std::vector<bool> cull() const;
+        void build_groups(const std::vector<bool>& alive);
+        std::int32_t allocate_images();
+        std::optional<render_graph_access_t> next_access(std::uint32_t resource, std::uint32_t group_index) const;
+        std::int32_t build_render_pass(group_t& group, std::uint32_t group_index, std::vector<resource_state_t>& states);
+
+    public:
+        void add_color_resource(const std::string& name, VkFormat format, VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_1_BIT);
+        void add_depth_resource(const std::string& name, VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_1_BIT);
+        void add_swap_chain_resource(const std::string& name);
+        void set_output(const std::string& name);
+        render_graph_pass_t& add_pass(const std::string& name);
+
+        std::int32_t compile(vulkan_context_t* context);
+        render_pass_t* get_render_pass(const std::string& pass) const;
+        std::optional<std::uint32_t> get_subpass(const std::string& pass) const;
+        const std::vector<VkClearValue>& get_clear_values(const std::string& pass) const;
+        image_t** get_image(const std::string& resource) const;
+};
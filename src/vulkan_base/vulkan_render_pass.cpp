@@ -119,6 +119,15 @@ std::int32_t render_pass_t::init(const render_pass_settings_t& settings, const V
     create_info.dependencyCount = static_cast<std::uint32_t>(settings.dependencies.size());
     create_info.pDependencies = settings.dependencies.data();
 
+    std::vector<std::uint32_t> view_masks(settings.subpasses.size(), settings.view_mask);
+    VkRenderPassMultiviewCreateInfo multiview_info{};
+    multiview_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+    multiview_info.subpassCount = static_cast<std::uint32_t>(view_masks.size());
+    multiview_info.pViewMasks = view_masks.data();
+    multiview_info.correlationMaskCount = 1;
+    multiview_info.pCorrelationMasks = &settings.view_mask;
+    if (settings.view_mask != 0) create_info.pNext = &multiview_info;
+
     if (vkCreateRenderPass(device, &create_info, nullptr, &this->render_pass) != VK_SUCCESS)
     {
         std::cerr << "Failed to create render pass!" << std::endl;
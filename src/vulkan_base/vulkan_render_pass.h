@@ -12,6 +12,7 @@ struct subpass_t
     std::vector<VkAttachmentReference> depth_attachment_reference = {{}};
     std::vector<VkAttachmentReference> color_attachment_resolve_references;
     std::vector<VkAttachmentReference> input_attachment_references;
+    std::vector<std::uint32_t> preserve_attachments;
 };
 
 struct render_pass_settings_t
@@ -19,6 +20,8 @@ struct render_pass_settings_t
     std::vector<VkAttachmentDescription> attachments;
     std::vector<subpass_t> subpasses;
     std::vector<VkSubpassDependency> dependencies;
+    /// Every subpass is broadcast to each view set in the mask, the framebuffer attachments need one layer per view.
+    std::uint32_t view_mask = 0;
 
     /// If the input attachments are not sequential you need to specify them manually before submitting the settings struct.
     void add_subpass(VkFormat format, VkSampleCountFlagBits msaa_samples, const VkPhysicalDevice* physical_device,
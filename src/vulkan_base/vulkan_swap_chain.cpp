@@ -127,8 +127,41 @@ std::int32_t swap_chain_t::init(const logical_device_t* logical_device, VkSurfac
     return 0;
 }
 
+std::int32_t swap_chain_t::init_offscreen(const logical_device_t* logical_device, const VkPhysicalDevice* physical_device, const VkCommandPool* command_pool,
+        VkExtent2D extent, std::uint32_t image_count)
+{
+    this->format = { VK_FORMAT_R8G8B8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+    this->present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    this->extent = extent;
+    this->final_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    this->device = &(logical_device->device);
+
+    image_settings_t settings;
+    settings.format = this->format.format;
+    settings.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    DEBUG_PRINT("Available Offscreen Images: " << image_count)
+    for (std::uint32_t i = 0; i < image_count; ++i)
+    {
+        image_t* image = new image_t(physical_device, command_pool);
+        this->offscreen_images.push_back(image);
+        if (image->init_color_buffer(settings, extent, logical_device) != 0)
+        {
+            std::cerr << "Failed to create offscreen image!" << std::endl;
+            return -1;
+        }
+        this->images.push_back(image->image);
+        this->image_views.push_back(image->view);
+    }
+
+    return 0;
+}
+
 swap_chain_t::swap_chain_t(const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface)
 {
+    if (surface == VK_NULL_HANDLE)
+    {
+        return;
+    }
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &(this->capabilities));
     
     std::uint32_t format_count = 0;
@@ -154,6 +187,15 @@ swap_chain_t::~swap_chain_t()
     {
         return;
     }
+    if (this->swap_chain == VK_NULL_HANDLE)
+    {
+        for (image_t* image : this->offscreen_images)
+        {
+            delete image;
+        }
+        DEBUG_PRINT("Destroying Offscreen Images!")
+        return;
+    }
     for (VkImageView image_view : this->image_views)
     {
         vkDestroyImageView(*(this->device), image_view, nullptr);
@@ -6,6 +6,8 @@
 #include <cstdint>
 #include <vulkan/vulkan_core.h>
 
+class image_t;
+
 class swap_chain_t
 {
     private:
@@ -21,15 +23,19 @@ class swap_chain_t
         void choose_extent(GLFWwindow* window);
 
     public:
-        VkSwapchainKHR swap_chain;
+        VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
         std::vector<VkImage> images;
+        std::vector<image_t*> offscreen_images;
         std::vector<VkImageView> image_views;
         VkSurfaceFormatKHR format;
         VkPresentModeKHR present_mode;
         VkExtent2D extent;
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         bool is_adequate();
         std::int32_t init(const logical_device_t* logical_device, VkSurfaceKHR& surface, GLFWwindow* window);
+        std::int32_t init_offscreen(const logical_device_t* logical_device, const VkPhysicalDevice* physical_device, const VkCommandPool* command_pool,
+                VkExtent2D extent, std::uint32_t image_count);
         swap_chain_t(const VkPhysicalDevice& physical_device, const VkSurfaceKHR& surface);
         ~swap_chain_t();
 };
@@ -0,0 +1,453 @@
+#include "vulkan_upload_context.h"
+#include <cstring>
+#include <iostream>
+
+#include "debug_print.h"
+
+std::int32_t upload_context_t::create_command_pool(std::uint32_t queue_family, VkCommandPool* pool)
+{
+    VkCommandPoolCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    create_info.queueFamilyIndex = queue_family;
+
+    if (vkCreateCommandPool(this->device->device, &create_info, this->allocator, pool) != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create upload command pool!" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+std::int32_t upload_context_t::init(const logical_device_t* device, const VkPhysicalDevice* physical_device, VkDeviceSize staging_size)
+{
+    this->device = device;
+    this->physical_device = physical_device;
+    this->dedicated_transfer = device->has_dedicated_transfer();
+
+    if (create_command_pool(device->indices.graphics_family.value(), &this->command_pool) != 0) return -1;
+    this->transfer_command_pool = this->command_pool;
+    if (this->dedicated_transfer)
+    {
+        if (create_command_pool(device->indices.transfer_family.value(), &this->transfer_command_pool) != 0) return -1;
+    }
+
+    this->staging_settings.size = staging_size;
+    this->staging_settings.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    this->staging_settings.memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    this->staging_buffer = new buffer_t(this->physical_device, &this->command_pool);
+    if (this->staging_buffer->init(this->staging_settings, this->device) != 0)
+    {
+        std::cerr << "Failed to create staging ring buffer!" << std::endl;
+        return -1;
+    }
+    this->staging_buffer->map_memory();
+
+    return 0;
+}
+
+std::int32_t upload_context_t::begin_batch()
+{
+    batch_t* batch = nullptr;
+    if (!this->free_batches.empty())
+    {
+        batch = this->free_batches.back();
+        this->free_batches.pop_back();
+    }
+    else
+    {
+        batch = new batch_t();
+
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = this->command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        if (vkAllocateCommandBuffers(this->device->device, &alloc_info, &batch->command_buffer) != VK_SUCCESS ||
+                vkCreateFence(this->device->device, &fence_info, this->allocator, &batch->fence) != VK_SUCCESS)
+        {
+            std::cerr << "Failed to create upload batch!" << std::endl;
+            delete batch;
+            return -1;
+        }
+
+        batch->transfer_command_buffer = batch->command_buffer;
+        if (this->dedicated_transfer)
+        {
+            alloc_info.commandPool = this->transfer_command_pool;
+
+            VkSemaphoreCreateInfo semaphore_info{};
+            semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+            if (vkAllocateCommandBuffers(this->device->device, &alloc_info, &batch->transfer_command_buffer) != VK_SUCCESS ||
+                    vkCreateSemaphore(this->device->device, &semaphore_info, this->allocator, &batch->transfer_finished) != VK_SUCCESS)
+            {
+                std::cerr << "Failed to create upload batch!" << std::endl;
+                delete batch;
+                return -1;
+            }
+        }
+    }
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(batch->command_buffer, &begin_info) != VK_SUCCESS ||
+            (this->dedicated_transfer && vkBeginCommandBuffer(batch->transfer_command_buffer, &begin_info) != VK_SUCCESS))
+    {
+        std::cerr << "Failed to begin upload command buffer!" << std::endl;
+        this->free_batches.push_back(batch);
+        return -1;
+    }
+
+    batch->id = this->next_id++;
+    batch->has_staging = false;
+    this->current = batch;
+
+    return 0;
+}
+
+void upload_context_t::retire_oldest()
+{
+    batch_t* batch = this->pending_batches.front();
+    this->pending_batches.pop_front();
+
+    vkWaitForFences(this->device->device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(this->device->device, 1, &batch->fence);
+    vkResetCommandBuffer(batch->command_buffer, 0);
+    if (this->dedicated_transfer) vkResetCommandBuffer(batch->transfer_command_buffer, 0);
+    for (std::pair<buffer_t*, buffer_settings_t*>& temporary : batch->temporary_buffers)
+    {
+        delete temporary.first;
+        delete temporary.second;
+    }
+    batch->temporary_buffers.clear();
+    this->completed_id = batch->id;
+    this->free_batches.push_back(batch);
+
+    if (!batch->has_staging)
+    {
+        return;
+    }
+
+    std::optional<VkDeviceSize> next_begin = std::nullopt;
+    for (batch_t* pending : this->pending_batches)
+    {
+        if (pending->has_staging)
+        {
+            next_begin = pending->ring_begin;
+            break;
+        }
+    }
+    if (!next_begin.has_value() && this->current != nullptr && this->current->has_staging)
+    {
+        next_begin = this->current->ring_begin;
+    }
+
+    if (!next_begin.has_value())
+    {
+        this->head = 0;
+        this->tail = 0;
+        this->wrapped = false;
+        return;
+    }
+    if (next_begin.value() < this->tail)
+    {
+        this->wrapped = false;
+    }
+    this->tail = next_begin.value();
+}
+
+std::optional<VkDeviceSize> upload_context_t::reserve(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize offset = (this->head + alignment - 1) / alignment * alignment;
+    if (!this->wrapped)
+    {
+        if (offset + size > this->staging_settings.size)
+        {
+            if (size > this->tail)
+            {
+                return std::nullopt;
+            }
+            offset = 0;
+            this->wrapped = true;
+        }
+    }
+    else if (offset + size > this->tail)
+    {
+        return std::nullopt;
+    }
+
+    this->head = offset + size;
+    return offset;
+}
+
+std::optional<std::pair<VkBuffer, VkDeviceSize>> upload_context_t::stage(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (this->current == nullptr && begin_batch() != 0)
+    {
+        return std::nullopt;
+    }
+
+    // large uploads would drain the ring and force a wait, give them their own staging buffer instead
+    if (size > this->staging_settings.size / 2)
+    {
+        buffer_settings_t* settings = new buffer_settings_t();
+        settings->size = size;
+        settings->usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        settings->memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        buffer_t* buffer = new buffer_t(this->physical_device, &this->command_pool);
+        if (buffer->init(*settings, this->device) != 0 || buffer->set_data(const_cast<void*>(data)) != 0)
+        {
+            delete buffer;
+            delete settings;
+            return std::nullopt;
+        }
+        this->current->temporary_buffers.emplace_back(buffer, settings);
+        return std::make_pair(buffer->buffer, VkDeviceSize(0));
+    }
+
+    bool live = this->current->has_staging;
+    for (batch_t* pending : this->pending_batches) live |= pending->has_staging;
+    if (!live)
+    {
+        this->head = 0;
+        this->tail = 0;
+        this->wrapped = false;
+    }
+
+    std::optional<VkDeviceSize> offset = reserve(size, alignment);
+    while (!offset.has_value())
+    {
+        if (this->pending_batches.empty())
+        {
+            flush();
+        }
+        retire_oldest();
+        if (this->current == nullptr && begin_batch() != 0)
+        {
+            return std::nullopt;
+        }
+        offset = reserve(size, alignment);
+    }
+
+    if (!this->current->has_staging)
+    {
+        this->current->ring_begin = offset.value();
+        this->current->has_staging = true;
+    }
+    std::memcpy(static_cast<std::uint8_t*>(this->staging_buffer->mapped_memory) + offset.value(), data, static_cast<std::size_t>(size));
+
+    return std::make_pair(this->staging_buffer->buffer, offset.value());
+}
+
+VkCommandBuffer upload_context_t::get_command_buffer()
+{
+    if (this->current == nullptr && begin_batch() != 0)
+    {
+        return VK_NULL_HANDLE;
+    }
+    return this->current->command_buffer;
+}
+
+VkCommandBuffer upload_context_t::get_transfer_command_buffer()
+{
+    if (this->current == nullptr && begin_batch() != 0)
+    {
+        return VK_NULL_HANDLE;
+    }
+    return this->current->transfer_command_buffer;
+}
+
+void upload_context_t::transfer_ownership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dst_access)
+{
+    if (!this->dedicated_transfer)
+    {
+        return;
+    }
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = this->device->indices.transfer_family.value();
+    barrier.dstQueueFamilyIndex = this->device->indices.graphics_family.value();
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(get_transfer_command_buffer(),
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(get_command_buffer(),
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+}
+
+void upload_context_t::transfer_ownership(VkImage image, VkImageLayout layout, const VkImageSubresourceRange& range, VkAccessFlags dst_access)
+{
+    if (!this->dedicated_transfer)
+    {
+        return;
+    }
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = layout;
+    barrier.newLayout = layout;
+    barrier.srcQueueFamilyIndex = this->device->indices.transfer_family.value();
+    barrier.dstQueueFamilyIndex = this->device->indices.graphics_family.value();
+    barrier.image = image;
+    barrier.subresourceRange = range;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(get_transfer_command_buffer(),
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(get_command_buffer(),
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+}
+
+std::int32_t upload_context_t::upload_buffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset)
+{
+    std::optional<std::pair<VkBuffer, VkDeviceSize>> staged = stage(data, size);
+    if (!staged.has_value())
+    {
+        std::cerr << "Failed to stage buffer upload!" << std::endl;
+        return -1;
+    }
+
+    VkBufferCopy copy_region{};
+    copy_region.srcOffset = staged->second;
+    copy_region.dstOffset = dst_offset;
+    copy_region.size = size;
+    vkCmdCopyBuffer(get_transfer_command_buffer(), staged->first, dst, 1, &copy_region);
+    transfer_ownership(dst, dst_offset, size, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+    return 0;
+}
+
+std::uint64_t upload_context_t::flush()
+{
+    if (this->current == nullptr)
+    {
+        return this->next_id - 1;
+    }
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+        | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(this->current->command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+
+    vkEndCommandBuffer(this->current->command_buffer);
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    if (this->dedicated_transfer)
+    {
+        vkEndCommandBuffer(this->current->transfer_command_buffer);
+
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &this->current->transfer_command_buffer;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &this->current->transfer_finished;
+        if (vkQueueSubmit(this->device->transfer_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            std::cerr << "Failed to submit upload batch to transfer queue!" << std::endl;
+        }
+
+        submit_info.signalSemaphoreCount = 0;
+        submit_info.pSignalSemaphores = nullptr;
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &this->current->transfer_finished;
+        submit_info.pWaitDstStageMask = &wait_stage;
+    }
+
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &this->current->command_buffer;
+    if (vkQueueSubmit(this->device->graphics_queue, 1, &submit_info, this->current->fence) != VK_SUCCESS)
+    {
+        std::cerr << "Failed to submit upload batch!" << std::endl;
+    }
+
+    std::uint64_t id = this->current->id;
+    this->pending_batches.push_back(this->current);
+    this->current = nullptr;
+
+    return id;
+}
+
+bool upload_context_t::is_complete(std::uint64_t id)
+{
+    while (!this->pending_batches.empty() && vkGetFenceStatus(this->device->device, this->pending_batches.front()->fence) == VK_SUCCESS)
+    {
+        retire_oldest();
+    }
+    return this->completed_id >= id;
+}
+
+void upload_context_t::wait(std::uint64_t id)
+{
+    if (this->current != nullptr && this->current->id <= id)
+    {
+        flush();
+    }
+    while (this->completed_id < id && !this->pending_batches.empty())
+    {
+        retire_oldest();
+    }
+}
+
+void upload_context_t::wait_idle()
+{
+    wait(flush());
+}
+
+upload_context_t::upload_context_t()
+{
+}
+
+upload_context_t::~upload_context_t()
+{
+    if (this->device == nullptr) return;
+    wait_idle();
+    for (batch_t* batch : this->free_batches)
+    {
+        vkDestroyFence(this->device->device, batch->fence, this->allocator);
+        if (this->dedicated_transfer) vkDestroySemaphore(this->device->device, batch->transfer_finished, this->allocator);
+        delete batch;
+    }
+    delete this->staging_buffer;
+    if (this->dedicated_transfer) vkDestroyCommandPool(this->device->device, this->transfer_command_pool, this->allocator);
+    vkDestroyCommandPool(this->device->device, this->command_pool, this->allocator);
+    DEBUG_PRINT("Destroying Upload Context!")
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "vulkan_buffer.h"
+#include "vulkan_logical_device.h"
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+class upload_context_t
+{
+    private:
+        struct batch_t
+        {
+            VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+            VkCommandBuffer transfer_command_buffer = VK_NULL_HANDLE;
+            VkSemaphore transfer_finished = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            std::uint64_t id = 0;
+            VkDeviceSize ring_begin = 0;
+            bool has_staging = false;
+            std::vector<std::pair<buffer_t*, buffer_settings_t*>> temporary_buffers;
+        };
+
+        const logical_device_t* device = nullptr;
+        const VkPhysicalDevice* physical_device = nullptr;
+        const VkAllocationCallbacks* allocator = nullptr;
+        VkCommandPool command_pool = VK_NULL_HANDLE;
+        VkCommandPool transfer_command_pool = VK_NULL_HANDLE;
+        bool dedicated_transfer = false;
+        buffer_settings_t staging_settings;
+        buffer_t* staging_buffer = nullptr;
+        VkDeviceSize head = 0;
+        VkDeviceSize tail = 0;
+        bool wrapped = false;
+        std::vector<batch_t*> free_batches;
+        std::deque<batch_t*> pending_batches;
+        batch_t* current = nullptr;
+        std::uint64_t next_id = 1;
+        std::uint64_t completed_id = 0;
+
+        std::int32_t create_command_pool(std::uint32_t queue_family, VkCommandPool* pool);
+        std::int32_t begin_batch();
+        void retire_oldest();
+        std::optional<VkDeviceSize> reserve(VkDeviceSize size, VkDeviceSize alignment);
+
+    public:
+        std::int32_t init(const logical_device_t* device, const VkPhysicalDevice* physical_device, VkDeviceSize staging_size = 64 * 1024 * 1024);
+        // stage before asking for the command buffer, staging may flush the batch when the ring is full
+        std::optional<std::pair<VkBuffer, VkDeviceSize>> stage(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+        VkCommandBuffer get_command_buffer();
+        VkCommandBuffer get_transfer_command_buffer();
+        void transfer_ownership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dst_access);
+        void transfer_ownership(VkImage image, VkImageLayout layout, const VkImageSubresourceRange& range, VkAccessFlags dst_access);
+        std::int32_t upload_buffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset = 0);
+        std::uint64_t flush();
+        bool is_complete(std::uint64_t id);
+        void wait(std::uint64_t id);
+        void wait_idle();
+        upload_context_t();
+        ~upload_context_t();
+};
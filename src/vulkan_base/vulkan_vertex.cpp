@@ -1,4 +1,7 @@
 #include "vulkan_vertex.h"
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
 
 bool vertex_t::operator==(const vertex_t& other) const
 {
@@ -41,6 +44,127 @@ std::array<VkVertexInputAttributeDescription, 4> vertex_t::get_attribute_descrip
     return attribute_descriptions;
 }
 
+std::uint32_t get_vertex_size(vertex_format_t format)
+{
+    switch (format)
+    {
+        case VERTEX_FORMAT_PACKED:
+            return sizeof(packed_vertex_t);
+        case VERTEX_FORMAT_PACKED_QUANTIZED:
+            return sizeof(quantized_vertex_t);
+        default:
+            return sizeof(vertex_t);
+    }
+}
+
+VkVertexInputBindingDescription get_vertex_binding_description(vertex_format_t format)
+{
+    VkVertexInputBindingDescription binding_description = vertex_t::get_binding_description();
+    binding_description.stride = get_vertex_size(format);
+
+    return binding_description;
+}
+
+std::vector<VkVertexInputAttributeDescription> get_vertex_attribute_descriptions(vertex_format_t format)
+{
+    std::array<VkVertexInputAttributeDescription, 4> full = vertex_t::get_attribute_description();
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions(full.begin(), full.end());
+    if (format == VERTEX_FORMAT_FULL)
+    {
+        return attribute_descriptions;
+    }
+
+    attribute_descriptions[1].format = VK_FORMAT_R16G16_SNORM;
+    attribute_descriptions[2].format = VK_FORMAT_R16G16_SNORM;
+    attribute_descriptions[3].format = VK_FORMAT_R16G16_SFLOAT;
+    if (format == VERTEX_FORMAT_PACKED)
+    {
+        attribute_descriptions[0].offset = offsetof(packed_vertex_t, pos);
+        attribute_descriptions[1].offset = offsetof(packed_vertex_t, normal);
+        attribute_descriptions[2].offset = offsetof(packed_vertex_t, tangent);
+        attribute_descriptions[3].offset = offsetof(packed_vertex_t, tex_coord);
+    }
+    else
+    {
+        attribute_descriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attribute_descriptions[0].offset = offsetof(quantized_vertex_t, pos);
+        attribute_descriptions[1].offset = offsetof(quantized_vertex_t, normal);
+        attribute_descriptions[2].offset = offsetof(quantized_vertex_t, tangent);
+        attribute_descriptions[3].offset = offsetof(quantized_vertex_t, tex_coord);
+    }
+
+    return attribute_descriptions;
+}
+
+glm::vec2 octahedral_encode(glm::vec3 n)
+{
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (sum == 0.0f)
+    {
+        return glm::vec2(0.0f);
+    }
+    n /= sum;
+    glm::vec2 res(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+        res.x = (1.0f - std::abs(n.y)) * ((n.x >= 0.0f) ? 1.0f : -1.0f);
+        res.y = (1.0f - std::abs(n.x)) * ((n.y >= 0.0f) ? 1.0f : -1.0f);
+    }
+    return res;
+}
+
+std::vector<std::uint8_t> pack_vertices(const std::vector<vertex_t>& vertices, vertex_format_t format, vertex_dequant_t& dequant)
+{
+    dequant = vertex_dequant_t();
+    std::uint32_t stride = get_vertex_size(format);
+    std::vector<std::uint8_t> data(vertices.size() * stride);
+    if (format == VERTEX_FORMAT_FULL)
+    {
+        std::memcpy(data.data(), vertices.data(), data.size());
+        return data;
+    }
+
+    glm::vec3 min_pos(0.0f), extent(1.0f);
+    if (format == VERTEX_FORMAT_PACKED_QUANTIZED && !vertices.empty())
+    {
+        min_pos = vertices[0].pos;
+        glm::vec3 max_pos = vertices[0].pos;
+        for (const vertex_t& vertex : vertices)
+        {
+            min_pos = glm::min(min_pos, vertex.pos);
+            max_pos = glm::max(max_pos, vertex.pos);
+        }
+        extent = max_pos - min_pos;
+        for (std::uint32_t i = 0; i < 3; ++i)
+        {
+            if (extent[i] <= 0.0f) extent[i] = 1.0f;
+        }
+        dequant.offset = glm::vec4(min_pos, 0.0f);
+        dequant.scale = glm::vec4(extent, 1.0f);
+    }
+
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        const vertex_t& vertex = vertices[i];
+        std::uint32_t normal = glm::packSnorm2x16(octahedral_encode(vertex.normal));
+        std::uint32_t tangent = glm::packSnorm2x16(octahedral_encode(vertex.tangent));
+        std::uint32_t tex_coord = glm::packHalf2x16(vertex.tex_coord);
+        if (format == VERTEX_FORMAT_PACKED)
+        {
+            packed_vertex_t packed = { vertex.pos, normal, tangent, tex_coord };
+            std::memcpy(data.data() + i * stride, &packed, stride);
+        }
+        else
+        {
+            glm::vec3 pos = (vertex.pos - min_pos) / extent;
+            quantized_vertex_t quantized = { { glm::packUnorm1x16(pos.x), glm::packUnorm1x16(pos.y), glm::packUnorm1x16(pos.z), 0 }, normal, tangent, tex_coord };
+            std::memcpy(data.data() + i * stride, &quantized, stride);
+        }
+    }
+
+    return data;
+}
+
 namespace std
 {
     size_t hash<vertex_t>::operator()(vertex_t const& vertex) const
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
 #define GLM_FORCE_RADIANS
@@ -22,6 +24,42 @@ struct vertex_t
     static std::array<VkVertexInputAttributeDescription, 4> get_attribute_description();
 };
 
+enum vertex_format_t
+{
+    VERTEX_FORMAT_FULL,
+    VERTEX_FORMAT_PACKED,
+    VERTEX_FORMAT_PACKED_QUANTIZED
+};
+
+// positions of quantized vertices are reconstructed as offset + scale * pos in the vertex shader
+struct vertex_dequant_t
+{
+    alignas(16) glm::vec4 offset = glm::vec4(0.0f);
+    alignas(16) glm::vec4 scale = glm::vec4(1.0f);
+};
+
+// octahedral encoded normal and tangent as snorm16x2, tex coords as half floats
+struct packed_vertex_t
+{
+    glm::vec3 pos;
+    std::uint32_t normal;
+    std::uint32_t tangent;
+    std::uint32_t tex_coord;
+};
+
+struct quantized_vertex_t
+{
+    std::uint16_t pos[4];
+    std::uint32_t normal;
+    std::uint32_t tangent;
+    std::uint32_t tex_coord;
+};
+
+std::uint32_t get_vertex_size(vertex_format_t format);
+VkVertexInputBindingDescription get_vertex_binding_description(vertex_format_t format);
+std::vector<VkVertexInputAttributeDescription> get_vertex_attribute_descriptions(vertex_format_t format);
+std::vector<std::uint8_t> pack_vertices(const std::vector<vertex_t>& vertices, vertex_format_t format, vertex_dequant_t& dequant);
+
 namespace std
 {
     template<> struct hash<vertex_t>